@@ -0,0 +1,23 @@
+#version 120
+
+uniform mat4 P;
+uniform mat4 MV;
+uniform mat3 T;
+
+attribute vec4 aPos; // in object space
+attribute vec3 aNor; // in object space
+attribute vec2 aTex;
+attribute vec4 aInst; // center (xyz) and scale (w) of the sphere instance
+
+varying vec3 vertPos; // Pass to fragment shader
+varying vec3 normal;  // Pass to fragment shader
+varying vec2 vTex;
+
+void main()
+{
+    vec4 pos = vec4(aPos.xyz * aInst.w + aInst.xyz, 1.0);
+	gl_Position = P * MV * pos;
+    vTex = (T * vec3(aTex, 1.0)).xy;
+    normal = (MV * vec4(aNor, 0.0)).xyz;
+    vertPos = vec3(MV * pos);
+}
@@ -0,0 +1,169 @@
+//
+//  Bodies.cpp
+//  SphereOctree
+//
+
+#include "Bodies.h"
+#include <cmath>
+
+using namespace std;
+
+// Tells the compiler that the iterations of the next loop do not depend on
+// each other through memory. The arrays of Bodies never overlap, but there are
+// too many of them for the compiler to check each pair at run time, so it
+// would not vectorize the loop otherwise.
+#if defined(__clang__)
+#define INDEPENDENT_ITERATIONS _Pragma("clang loop vectorize(assume_safety)")
+#elif defined(__GNUC__)
+#define INDEPENDENT_ITERATIONS _Pragma("GCC ivdep")
+#elif defined(_MSC_VER)
+#define INDEPENDENT_ITERATIONS __pragma(loop(ivdep))
+#else
+#define INDEPENDENT_ITERATIONS
+#endif
+
+namespace {
+
+// Rotates the quaternion q by the angular velocity w for the time dt:
+// q = (1, w dt / 2) * q, normalized. For the small angle of a step, this is
+// close to the exact rotation (cos(|w| dt / 2), sin(|w| dt / 2) w / |w|), but
+// it needs neither a branch nor cos and sin, so the loop of integrate() can be
+// vectorized. It rotates by 2 atan(|w| dt / 2), which is never more than
+// |w| dt, so maxMovement() is still a bound. For dt = 0, q is only normalized.
+inline void rotate(float &qw, float &qx, float &qy, float &qz, float wx,
+                   float wy, float wz, float dt) {
+  float dx = 0.5f * dt * wx, dy = 0.5f * dt * wy, dz = 0.5f * dt * wz;
+  float nw = qw - dx * qx - dy * qy - dz * qz;
+  float nx = qx + dx * qw + dy * qz - dz * qy;
+  float ny = qy - dx * qz + dy * qw + dz * qx;
+  float nz = qz + dx * qy - dy * qx + dz * qw;
+  float norm = 1.0f / sqrt(nw * nw + nx * nx + ny * ny + nz * nz);
+  qw = nw * norm;
+  qx = nx * norm;
+  qy = ny * norm;
+  qz = nz * norm;
+}
+
+// Returns the transform of a position and an orientation.
+Eigen::Matrix4f toMatrix(const Eigen::Vector3f &p,
+                         const Eigen::Quaternionf &q) {
+  Eigen::Matrix4f m = Eigen::Matrix4f::Identity();
+  m.topLeftCorner<3, 3>() = q.toRotationMatrix();
+  m.topRightCorner<3, 1>() = p;
+  return m;
+}
+
+} // namespace
+
+size_t Bodies::add() {
+  for (auto a : {&px, &py, &pz, &vx, &vy, &vz, &qx, &qy, &qz, &wx, &wy, &wz,
+                 &lastPx, &lastPy, &lastPz, &lastQx, &lastQy, &lastQz})
+    a->push_back(0.0f);
+  qw.push_back(1.0f);
+  lastQw.push_back(1.0f);
+  steps.push_back(0);
+  transforms.push_back(Eigen::Matrix4f::Identity());
+  inverses.push_back(Eigen::Matrix4f::Identity());
+  return px.size() - 1;
+}
+
+void Bodies::set(size_t i, const Eigen::Vector3f &position,
+                 const Eigen::Vector3f &velocity,
+                 const Eigen::Quaternionf &orientation,
+                 const Eigen::Vector3f &angularVelocity) {
+  lastPx[i] = px[i] = position.x();
+  lastPy[i] = py[i] = position.y();
+  lastPz[i] = pz[i] = position.z();
+  vx[i] = velocity.x();
+  vy[i] = velocity.y();
+  vz[i] = velocity.z();
+  Eigen::Quaternionf q = orientation.normalized();
+  lastQw[i] = qw[i] = q.w();
+  lastQx[i] = qx[i] = q.x();
+  lastQy[i] = qy[i] = q.y();
+  lastQz[i] = qz[i] = q.z();
+  wx[i] = angularVelocity.x();
+  wy[i] = angularVelocity.y();
+  wz[i] = angularVelocity.z();
+  steps[i] = 0;
+  updateTransform(i);
+}
+
+void Bodies::integrate(const vector<float> &fractions) {
+  size_t n = size();
+  INDEPENDENT_ITERATIONS
+  for (size_t i = 0; i < n; ++i) {
+    float dt = fractions[i] * timeStep;
+    lastPx[i] = px[i];
+    lastPy[i] = py[i];
+    lastPz[i] = pz[i];
+    px[i] += dt * vx[i];
+    py[i] += dt * vy[i];
+    pz[i] += dt * vz[i];
+    lastQw[i] = qw[i];
+    lastQx[i] = qx[i];
+    lastQy[i] = qy[i];
+    lastQz[i] = qz[i];
+    rotate(qw[i], qx[i], qy[i], qz[i], wx[i], wy[i], wz[i], dt);
+    ++steps[i];
+  }
+  // The transforms are Eigen matrices, which are computed one by one.
+  for (size_t i = 0; i < n; ++i) {
+    if (fractions[i] > 0.0f)
+      updateTransform(i);
+  }
+}
+
+void Bodies::integrate(size_t i, float fraction) {
+  float dt = fraction * timeStep;
+  lastPx[i] = px[i];
+  lastPy[i] = py[i];
+  lastPz[i] = pz[i];
+  px[i] += dt * vx[i];
+  py[i] += dt * vy[i];
+  pz[i] += dt * vz[i];
+  lastQw[i] = qw[i];
+  lastQx[i] = qx[i];
+  lastQy[i] = qy[i];
+  lastQz[i] = qz[i];
+  rotate(qw[i], qx[i], qy[i], qz[i], wx[i], wy[i], wz[i], dt);
+  ++steps[i];
+  if (fraction > 0.0f)
+    updateTransform(i);
+}
+
+Eigen::Matrix4f Bodies::predict(size_t i, float fraction) const {
+  if (fraction == 0.0f)
+    return transforms[i];
+  float dt = fraction * timeStep;
+  float w = qw[i], x = qx[i], y = qy[i], z = qz[i];
+  rotate(w, x, y, z, wx[i], wy[i], wz[i], dt);
+  return toMatrix(Eigen::Vector3f(px[i] + dt * vx[i], py[i] + dt * vy[i],
+                                  pz[i] + dt * vz[i]),
+                  Eigen::Quaternionf(w, x, y, z));
+}
+
+Eigen::Matrix4f Bodies::interpolate(size_t i, float alpha) const {
+  if (alpha >= 1.0f)
+    return transforms[i];
+  Eigen::Vector3f last(lastPx[i], lastPy[i], lastPz[i]);
+  Eigen::Quaternionf lastQ(lastQw[i], lastQx[i], lastQy[i], lastQz[i]);
+  return toMatrix((1.0f - alpha) * last + alpha * getPosition(i),
+                  lastQ.slerp(alpha, getOrientation(i)));
+}
+
+float Bodies::maxMovement(size_t i, float reach) const {
+  float speed = sqrt(vx[i] * vx[i] + vy[i] * vy[i] + vz[i] * vz[i]);
+  float angularSpeed = sqrt(wx[i] * wx[i] + wy[i] * wy[i] + wz[i] * wz[i]);
+  return (speed + angularSpeed * reach) * timeStep;
+}
+
+void Bodies::updateTransform(size_t i) {
+  transforms[i] = toMatrix(getPosition(i), getOrientation(i));
+  Eigen::Matrix3f inverseRotation =
+      transforms[i].topLeftCorner<3, 3>().transpose();
+  inverses[i] = Eigen::Matrix4f::Identity();
+  inverses[i].topLeftCorner<3, 3>() = inverseRotation;
+  inverses[i].topRightCorner<3, 1>() =
+      -(inverseRotation * transforms[i].topRightCorner<3, 1>());
+}
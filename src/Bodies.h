@@ -0,0 +1,98 @@
+//
+//  Bodies.h
+//  SphereOctree
+//
+
+#ifndef Bodies_h
+#define Bodies_h
+
+#define EIGEN_DONT_ALIGN_STATICALLY
+#include <Eigen/Dense>
+#include <Eigen/Geometry>
+
+#include <vector>
+
+// The motion state of many objects: position, velocity, orientation and
+// angular velocity. Each value is stored in its own array with one entry per
+// object, so integrate() moves all objects in one pass over a few contiguous
+// arrays. A WorldObject is a handle to one entry.
+class Bodies {
+  // Position and velocity in units per second.
+  std::vector<float> px, py, pz;
+  std::vector<float> vx, vy, vz;
+  // Orientation as unit quaternion and angular velocity in radians per
+  // second, as rotation axis times speed.
+  std::vector<float> qw, qx, qy, qz;
+  std::vector<float> wx, wy, wz;
+  // Position and orientation before the last step, to draw the objects
+  // between two steps.
+  std::vector<float> lastPx, lastPy, lastPz;
+  std::vector<float> lastQw, lastQx, lastQy, lastQz;
+  // Number of steps of each object since it was set.
+  std::vector<size_t> steps;
+  // Translation and rotation of each object and their inverse, computed once
+  // per step, if the object moved.
+  std::vector<Eigen::Matrix4f> transforms;
+  std::vector<Eigen::Matrix4f> inverses;
+  // Seconds simulated by one step.
+  float timeStep = 1.0f / 60.0f;
+
+  // Computes the transform and its inverse of an object.
+  void updateTransform(size_t i);
+
+public:
+  // Appends an object at rest at the origin and returns its index.
+  size_t add();
+
+  // Sets the state of an object and its step count to 0.
+  // @arg i: Index of the object
+  // @arg position: Position
+  // @arg velocity: Velocity in units per second
+  // @arg orientation: Orientation
+  // @arg angularVelocity: Rotation axis times the speed in radians per second
+  void set(size_t i, const Eigen::Vector3f &position,
+           const Eigen::Vector3f &velocity,
+           const Eigen::Quaternionf &orientation,
+           const Eigen::Vector3f &angularVelocity);
+
+  // Moves all objects by one time step. The loop only uses the arrays, so the
+  // compiler can vectorize it.
+  // @arg fractions: Fraction of the time step to move for each object, 0 for
+  //                 objects which do not move
+  void integrate(const std::vector<float> &fractions);
+
+  // Moves one object by a fraction of the time step.
+  void integrate(size_t i, float fraction);
+
+  // Returns the transform of an object after moving it by the given fraction
+  // of a time step, without changing it.
+  Eigen::Matrix4f predict(size_t i, float fraction) const;
+
+  // Returns the transform of an object between its state before and after the
+  // last step.
+  // @arg alpha: Fraction between both states
+  Eigen::Matrix4f interpolate(size_t i, float alpha) const;
+
+  // Returns how far a point at the given distance from the origin of an
+  // object can move at most in one time step.
+  float maxMovement(size_t i, float reach) const;
+
+  inline size_t size() const { return px.size(); }
+  inline void setTimeStep(float dt) { timeStep = dt; }
+  inline float getTimeStep() const { return timeStep; }
+  inline Eigen::Vector3f getPosition(size_t i) const {
+    return Eigen::Vector3f(px[i], py[i], pz[i]);
+  }
+  inline Eigen::Quaternionf getOrientation(size_t i) const {
+    return Eigen::Quaternionf(qw[i], qx[i], qy[i], qz[i]);
+  }
+  inline size_t getSteps(size_t i) const { return steps[i]; }
+  inline const Eigen::Matrix4f &getTransform(size_t i) const {
+    return transforms[i];
+  }
+  inline const Eigen::Matrix4f &getInverse(size_t i) const {
+    return inverses[i];
+  }
+};
+
+#endif /* Bodies_h */
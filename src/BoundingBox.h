@@ -9,7 +9,7 @@
 #ifndef BoundingBox_h
 #define BoundingBox_h
 
-#include "Shape.h"
+#include "Mesh.h"
 #include <memory>
 #include <vector>
 
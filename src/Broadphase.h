@@ -0,0 +1,34 @@
+//
+//  Broadphase.h
+//  SphereOctree
+//
+
+#ifndef Broadphase_h
+#define Broadphase_h
+
+#define EIGEN_DONT_ALIGN_STATICALLY
+#include <Eigen/Dense>
+
+#include <utility>
+#include <vector>
+
+// A broadphase finds the pairs of objects whose bounding boxes overlap, so only
+// these pairs have to be checked with their octrees.
+class Broadphase {
+public:
+  // Two object indices, the first one is smaller.
+  typedef std::pair<size_t, size_t> Pair;
+
+  virtual ~Broadphase() {}
+
+  // Sets the bounding boxes of all objects. The index of a box is the index of
+  // its object. If the number of objects changes, all objects are inserted
+  // again.
+  virtual void update(const std::vector<Eigen::AlignedBox3f> &bounds) = 0;
+
+  // Returns the pairs with overlapping boxes at the last update, sorted and
+  // without duplicates.
+  virtual const std::vector<Pair> &getPairs() const = 0;
+};
+
+#endif /* Broadphase_h */
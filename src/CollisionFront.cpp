@@ -0,0 +1,337 @@
+//
+//  CollisionFront.cpp
+//  SphereOctree
+//
+
+#include "CollisionFront.h"
+#include <algorithm>
+#include <limits>
+
+using namespace std;
+
+// Levels below the roots, where a parallel update splits the front into tasks.
+// With 8 children per node, there are up to 64^SPLIT_LEVEL subtree pairs.
+static const size_t SPLIT_LEVEL = 2;
+
+bool CollisionFront::update(shared_ptr<const OctreeNode> myRoot,
+                            shared_ptr<const OctreeNode> otherRoot,
+                            const Eigen::Matrix4f &myPosition,
+                            const Eigen::Matrix4f &myInverse,
+                            const Eigen::Matrix4f &otherPosition, bool exact,
+                            ContactBuffer &contacts,
+                            shared_ptr<ThreadPool> pool) {
+  // Only the movement of the objects relative to each other can change the
+  // distance of two spheres. Bound how far any sphere of the second object
+  // moved, seen from the first object.
+  Step step = {myPosition, otherPosition, 0.0f, exact};
+  Eigen::Matrix4f relative = myInverse * otherPosition;
+  if (front.empty()) {
+    FrontPair roots = {myRoot.get(), otherRoot.get(), 0.0f,
+                       numeric_limits<float>::infinity(), false};
+    front.push_back(roots);
+  } else {
+    float reach = otherRoot->getOrigin()->norm() + otherRoot->getRadius();
+    step.movement = (relative.topLeftCorner<3, 3>() -
+                     lastRelative.topLeftCorner<3, 3>()).norm() * reach +
+                    (relative.topRightCorner<3, 1>() -
+                     lastRelative.topRightCorner<3, 1>()).norm();
+  }
+  lastRelative = relative;
+
+  // Only objects whose root spheres overlap can have a large front.
+  next.clear();
+  if (pool != nullptr && pool->getNumThreads() > 1 &&
+      myRoot->getDeepness() > SPLIT_LEVEL &&
+      myRoot->distance(*otherRoot, myPosition, otherPosition) <= 0.0f)
+    updateParallel(myRoot->getDeepness() - SPLIT_LEVEL, step, *pool);
+  else
+    updateRange(0, front.size(), step, next);
+  front.swap(next);
+
+  bool collision = false;
+  for (auto it = front.begin(); it != front.end(); ++it) {
+    if (it->contact) {
+      Contact contact = {it->a->getId(), it->b->getId()};
+      contacts.push_back(contact);
+      collision = true;
+    }
+  }
+  return collision;
+}
+
+void CollisionFront::updateRange(size_t begin, size_t end, const Step &step,
+                                 vector<FrontPair> &out) const {
+  AncestorCache cache;
+  size_t i = begin;
+  while (i < end) {
+    FrontPair pair = front[i++];
+    pair.slack -= step.movement;
+    pair.ancestorSlack -= step.movement;
+    if (pair.ancestorSlack <= 0.0f) {
+      const OctreeNode *a = pair.a;
+      const OctreeNode *b = pair.b;
+      float d = 0.0f;
+      pair.ancestorSlack = checkAncestors(a, b, d, step, cache);
+      if (a != pair.a) {
+        // Remove the other pairs below (a, b), which were already added to
+        // the next front or are still in the current one.
+        while (!out.empty() && isBelow(out.back(), a, b))
+          out.pop_back();
+        while (i < end && isBelow(front[i], a, b))
+          ++i;
+        FrontPair separated = {a, b, d, pair.ancestorSlack, false};
+        out.push_back(separated);
+        continue;
+      }
+    }
+    if (pair.slack > 0.0f) {
+      out.push_back(pair);
+      continue;
+    }
+
+    float d = pair.a->distance(*pair.b, step.myPosition, step.otherPosition);
+    if (d <= 0.0f) {
+      expand(pair.a, pair.b, d, pair.ancestorSlack, step, out);
+    } else {
+      FrontPair separated = {pair.a, pair.b, d, pair.ancestorSlack, false};
+      out.push_back(separated);
+    }
+  }
+}
+
+void CollisionFront::updateParallel(size_t splitDeepness, const Step &step,
+                                    ThreadPool &pool) {
+  segments.clear();
+  AncestorCache cache;
+  // Appends a pair, which was updated by this thread.
+  auto append = [this](const FrontPair &pair) {
+    if (segments.empty() || segments.back().isTask) {
+      segments.push_back(Segment());
+      segments.back().isTask = false;
+    }
+    segments.back().pairs.push_back(pair);
+  };
+  // Appends a task for the pairs below 'root'.
+  auto appendTask = [this](const FrontPair &root, size_t begin, size_t end) {
+    segments.push_back(Segment());
+    Segment &segment = segments.back();
+    segment.isTask = true;
+    segment.root = root;
+    segment.begin = begin;
+    segment.end = end;
+  };
+  // Removes the pairs and tasks below (a, b). The tasks did not run yet.
+  auto removeBelow = [this](const OctreeNode *a, const OctreeNode *b) {
+    while (!segments.empty()) {
+      Segment &last = segments.back();
+      if (last.isTask) {
+        if (!isBelow(last.root, a, b))
+          break;
+        segments.pop_back();
+      } else {
+        while (!last.pairs.empty() && isBelow(last.pairs.back(), a, b))
+          last.pairs.pop_back();
+        if (!last.pairs.empty())
+          break;
+        segments.pop_back();
+      }
+    }
+  };
+  // Adds the overlapping pair (a, b) or the pairs below it. Pairs on the split
+  // level are expanded by tasks.
+  function<void(const OctreeNode *, const OctreeNode *, float, float)>
+      expandSplit = [&](const OctreeNode *a, const OctreeNode *b, float d,
+                        float ancestorSlack) {
+        if (a->getDeepness() <= splitDeepness && !a->isLeaf() &&
+            !b->isLeaf()) {
+          FrontPair root = {a, b, d, ancestorSlack, false};
+          appendTask(root, 0, 0);
+        } else if (a->isLeaf() || b->isLeaf()) {
+          vector<FrontPair> leaves;
+          expand(a, b, d, ancestorSlack, step, leaves);
+          append(leaves.front());
+        } else {
+          float childAncestorSlack = min(ancestorSlack, -d);
+          auto myChildren = a->getChildren();
+          auto otherChildren = b->getChildren();
+          for (auto itMe = myChildren->begin(); itMe != myChildren->end();
+               ++itMe) {
+            for (auto itOther = otherChildren->begin();
+                 itOther != otherChildren->end(); ++itOther) {
+              float childD = (*itMe)->distance(**itOther, step.myPosition,
+                                               step.otherPosition);
+              if (childD <= 0.0f) {
+                expandSplit(itMe->get(), itOther->get(), childD,
+                            childAncestorSlack);
+              } else {
+                FrontPair separated = {itMe->get(), itOther->get(), childD,
+                                       childAncestorSlack, false};
+                append(separated);
+              }
+            }
+          }
+        }
+      };
+
+  size_t i = 0;
+  while (i < front.size()) {
+    // All pairs below the same pair on the split level are one task.
+    if (front[i].a->getDeepness() < splitDeepness) {
+      FrontPair root = front[i];
+      while (root.a->getDeepness() < splitDeepness) {
+        root.a = root.a->getParent();
+        root.b = root.b->getParent();
+      }
+      size_t end = i + 1;
+      while (end < front.size() && isBelow(front[end], root.a, root.b))
+        ++end;
+
+      // The pair on the split level and the pairs above it are tested here,
+      // so a task never has to collapse its pairs above its root. The result
+      // is the same as the one of updateRange().
+      const OctreeNode *a = root.a;
+      const OctreeNode *b = root.b;
+      float d =
+          root.a->distance(*root.b, step.myPosition, step.otherPosition);
+      float ancestorSlack = checkAncestors(a, b, d, step, cache);
+      size_t begin = i;
+      i = end;
+      if (a != root.a) {
+        removeBelow(a, b);
+        while (i < front.size() && isBelow(front[i], a, b))
+          ++i;
+      } else if (d <= 0.0f) {
+        appendTask(root, begin, end);
+        continue;
+      }
+      FrontPair separated = {a, b, d, ancestorSlack, false};
+      append(separated);
+      continue;
+    }
+
+    FrontPair pair = front[i++];
+    pair.slack -= step.movement;
+    pair.ancestorSlack -= step.movement;
+    if (pair.ancestorSlack <= 0.0f) {
+      const OctreeNode *a = pair.a;
+      const OctreeNode *b = pair.b;
+      float d = 0.0f;
+      pair.ancestorSlack = checkAncestors(a, b, d, step, cache);
+      if (a != pair.a) {
+        removeBelow(a, b);
+        while (i < front.size() && isBelow(front[i], a, b))
+          ++i;
+        FrontPair separated = {a, b, d, pair.ancestorSlack, false};
+        append(separated);
+        continue;
+      }
+    }
+    if (pair.slack > 0.0f) {
+      append(pair);
+      continue;
+    }
+
+    float d = pair.a->distance(*pair.b, step.myPosition, step.otherPosition);
+    if (d <= 0.0f) {
+      expandSplit(pair.a, pair.b, d, pair.ancestorSlack);
+    } else {
+      FrontPair separated = {pair.a, pair.b, d, pair.ancestorSlack, false};
+      append(separated);
+    }
+  }
+
+  // Each task writes only into its own segment, so no locks are needed.
+  vector<function<void()>> tasks;
+  for (auto it = segments.begin(); it != segments.end(); ++it) {
+    if (!it->isTask)
+      continue;
+    Segment *segment = &*it;
+    tasks.push_back([this, segment, &step]() {
+      if (segment->begin == segment->end)
+        expand(segment->root.a, segment->root.b, segment->root.slack,
+               segment->root.ancestorSlack, step, segment->pairs);
+      else
+        updateRange(segment->begin, segment->end, step, segment->pairs);
+    });
+  }
+  pool.run(tasks);
+
+  for (auto it = segments.begin(); it != segments.end(); ++it)
+    next.insert(next.end(), it->pairs.begin(), it->pairs.end());
+}
+
+void CollisionFront::expand(const OctreeNode *a, const OctreeNode *b,
+                            float distance, float ancestorSlack,
+                            const Step &step, vector<FrontPair> &out) const {
+  // Like OctreeNode::checkCollision, both trees are descended at the same
+  // time. A pair of a leaf and an inner node stays in the front.
+  if (a->isLeaf() || b->isLeaf()) {
+    bool contact =
+        a->isLeaf() && b->isLeaf() &&
+        (!step.exact ||
+         a->facesIntersect(*b, step.myPosition, step.otherPosition));
+    FrontPair leaves = {a, b, distance, ancestorSlack, contact};
+    out.push_back(leaves);
+    return;
+  }
+
+  float childAncestorSlack = min(ancestorSlack, -distance);
+  auto myChildren = a->getChildren();
+  auto otherChildren = b->getChildren();
+  for (auto itMe = myChildren->begin(); itMe != myChildren->end(); ++itMe) {
+    for (auto itOther = otherChildren->begin(); itOther != otherChildren->end();
+         ++itOther) {
+      float d =
+          (*itMe)->distance(**itOther, step.myPosition, step.otherPosition);
+      if (d <= 0.0f) {
+        expand(itMe->get(), itOther->get(), d, childAncestorSlack, step, out);
+      } else {
+        FrontPair separated = {itMe->get(), itOther->get(), d,
+                               childAncestorSlack, false};
+        out.push_back(separated);
+      }
+    }
+  }
+}
+
+float CollisionFront::checkAncestors(const OctreeNode *&a,
+                                     const OctreeNode *&b, float &distance,
+                                     const Step &step,
+                                     AncestorCache &cache) const {
+  float overlap = numeric_limits<float>::infinity();
+  const OctreeNode *x = a;
+  const OctreeNode *y = b;
+  while (x->getParent() != nullptr && y->getParent() != nullptr) {
+    x = x->getParent();
+    y = y->getParent();
+    if (x->getDeepness() >= cache.entries.size())
+      cache.entries.resize(x->getDeepness() + 1);
+    AncestorCache::Entry &entry = cache.entries[x->getDeepness()];
+    if (entry.a != x || entry.b != y) {
+      entry.a = x;
+      entry.b = y;
+      entry.distance = x->distance(*y, step.myPosition, step.otherPosition);
+    }
+    if (entry.distance > 0.0f) {
+      // Only the pairs above the highest separated pair stay above it.
+      a = x;
+      b = y;
+      distance = entry.distance;
+      overlap = numeric_limits<float>::infinity();
+    } else {
+      overlap = min(overlap, -entry.distance);
+    }
+  }
+  return overlap;
+}
+
+bool CollisionFront::isBelow(const FrontPair &pair, const OctreeNode *a,
+                             const OctreeNode *b) {
+  const OctreeNode *x = pair.a;
+  const OctreeNode *y = pair.b;
+  while (x != nullptr && x->getDeepness() < a->getDeepness())
+    x = x->getParent();
+  while (y != nullptr && y->getDeepness() < b->getDeepness())
+    y = y->getParent();
+  return x == a && y == b;
+}
@@ -0,0 +1,141 @@
+//
+//  CollisionFront.h
+//  SphereOctree
+//
+
+#ifndef CollisionFront_h
+#define CollisionFront_h
+
+#define EIGEN_DONT_ALIGN_STATICALLY
+#include <Eigen/Dense>
+
+#include "OctreeNode.h"
+#include "ThreadPool.h"
+#include <memory>
+#include <vector>
+
+// A collision front is the list of node pairs of two octrees, where the last
+// collision check stopped: either the spheres of the pair were separated, or
+// one of the nodes is a leaf. The spheres of all pairs above a pair of the
+// front overlap. Since objects only move a little between two checks, the
+// front is updated from the last one instead of starting at the roots again.
+// Pairs which overlap are expanded downwards, and if a pair above a pair of the
+// front separates, all pairs below it are collapsed into it. Thus the front is
+// always the one of OctreeNode::checkCollision() for the current positions, no
+// matter how it got there.
+class CollisionFront {
+  struct FrontPair {
+    const OctreeNode *a;
+    const OctreeNode *b;
+    // Distance of the spheres at the last test, reduced by the movement since
+    // then. The pair can not overlap as long as this is positive.
+    float slack;
+    // Smallest overlap of the pairs above this one at the last test, reduced
+    // by the movement since then. All of them overlap as long as this is
+    // positive.
+    float ancestorSlack;
+    // True, if both nodes are leaves and collide.
+    bool contact;
+  };
+
+  // Positions of both objects for one update, and how far the spheres of the
+  // second object moved at most relative to the first one since the last
+  // update.
+  struct Step {
+    Eigen::Matrix4f myPosition;
+    Eigen::Matrix4f otherPosition;
+    float movement;
+    bool exact;
+  };
+
+  // Distances of the pairs above the last pair, whose ancestors were tested,
+  // indexed by deepness. Siblings are next to each other in the front, so
+  // they mostly ask for the same pairs.
+  struct AncestorCache {
+    struct Entry {
+      const OctreeNode *a = nullptr;
+      const OctreeNode *b = nullptr;
+      float distance = 0.0f;
+    };
+    std::vector<Entry> entries;
+  };
+
+  // A part of the next front during a parallel update. The parts below the
+  // split level are computed by tasks.
+  struct Segment {
+    std::vector<FrontPair> pairs;
+    bool isTask;
+    // Pair on the split level, all pairs of a task are below or equal to it.
+    FrontPair root;
+    // Range of the current front, which the task updates. If it is empty, the
+    // task expands the root pair.
+    size_t begin;
+    size_t end;
+  };
+
+  // The pairs are kept in depth-first order, so all pairs below a node pair
+  // are next to each other.
+  std::vector<FrontPair> front;
+  std::vector<FrontPair> next;
+  std::vector<Segment> segments;
+  // Position of the second object relative to the first one at the last
+  // update.
+  Eigen::Matrix4f lastRelative;
+
+  // Updates the pairs front[begin, end) and appends the new pairs to 'out'.
+  void updateRange(size_t begin, size_t end, const Step &step,
+                   std::vector<FrontPair> &out) const;
+
+  // Updates the front with the pool. Pairs above the split level are updated
+  // by the calling thread, the subtrees below are split into tasks.
+  void updateParallel(size_t splitDeepness, const Step &step,
+                      ThreadPool &pool);
+
+  // Adds the overlapping pair (a, b) or the pairs below it to 'out'.
+  // @arg ancestorSlack: Smallest overlap of the pairs above (a, b)
+  void expand(const OctreeNode *a, const OctreeNode *b, float distance,
+              float ancestorSlack, const Step &step,
+              std::vector<FrontPair> &out) const;
+
+  // Tests the pairs above (a, b) up to the roots. If one of them is
+  // separated, (a, b) is moved up to the highest separated one and 'distance'
+  // is set to its distance. Returns the smallest overlap of the pairs above
+  // the resulting (a, b).
+  float checkAncestors(const OctreeNode *&a, const OctreeNode *&b,
+                       float &distance, const Step &step,
+                       AncestorCache &cache) const;
+
+  // Returns true, if the pair is (a, b) or below it.
+  static bool isBelow(const FrontPair &pair, const OctreeNode *a,
+                      const OctreeNode *b);
+
+public:
+  // Updates the front for the new positions of both objects. Starts at the
+  // roots, if the front is empty. Returns true, if a leaf of the first tree
+  // collides with a leaf of the second. The octrees are not changed.
+  // @arg myRoot: Root node of the first octree
+  // @arg otherRoot: Root node of the second octree
+  // @arg myPosition: Transition matrix of the first octree
+  // @arg myInverse: Inverse of the transition matrix of the first octree
+  // @arg otherPosition: Transition matrix of the second octree
+  // @arg exact: If true, two overlapping leaves only collide if their faces
+  //             intersect
+  // @arg contacts: The colliding leaf pairs are appended to this buffer
+  // @arg pool: If not null and the front is large, the update is split into
+  //            tasks for the pool
+  bool update(std::shared_ptr<const OctreeNode> myRoot,
+              std::shared_ptr<const OctreeNode> otherRoot,
+              const Eigen::Matrix4f &myPosition,
+              const Eigen::Matrix4f &myInverse,
+              const Eigen::Matrix4f &otherPosition, bool exact,
+              ContactBuffer &contacts,
+              std::shared_ptr<ThreadPool> pool = nullptr);
+
+  // Removes all node pairs, so the next update starts at the roots.
+  inline void reset() { front.clear(); }
+
+  // Returns the number of node pairs in the front.
+  inline size_t size() const { return front.size(); }
+};
+
+#endif /* CollisionFront_h */
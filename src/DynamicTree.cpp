@@ -0,0 +1,330 @@
+//
+//  DynamicTree.cpp
+//  SphereOctree
+//
+
+#include "DynamicTree.h"
+#include <algorithm>
+#include <cassert>
+#include <limits>
+
+using namespace std;
+
+namespace {
+
+// Returns half the surface of a box, the cost of visiting it in a query.
+float area(const Eigen::AlignedBox3f &box) {
+  Eigen::Vector3f d = box.sizes();
+  return d.x() * d.y() + d.y() * d.z() + d.z() * d.x();
+}
+
+} // namespace
+
+DynamicTree::DynamicTree(float m) : margin(m) {}
+
+int DynamicTree::allocateNode() {
+  if (freeNodes < 0) {
+    nodes.push_back(Node());
+    freeNodes = nodes.size() - 1;
+    nodes.back().parent = -1;
+  }
+  int node = freeNodes;
+  freeNodes = nodes[node].parent;
+  nodes[node].parent = -1;
+  nodes[node].left = -1;
+  nodes[node].right = -1;
+  nodes[node].height = 0;
+  return node;
+}
+
+void DynamicTree::releaseNode(int node) {
+  nodes[node].parent = freeNodes;
+  nodes[node].height = -1;
+  freeNodes = node;
+}
+
+void DynamicTree::insert(size_t object, const Eigen::AlignedBox3f &box) {
+  if (object >= leaves.size()) {
+    leaves.resize(object + 1, -1);
+    boxes.resize(object + 1);
+  }
+  assert(leaves[object] < 0);
+  int leaf = allocateNode();
+  Eigen::Vector3f fat = Eigen::Vector3f::Constant(margin);
+  nodes[leaf].box = Eigen::AlignedBox3f(box.min() - fat, box.max() + fat);
+  nodes[leaf].object = object;
+  leaves[object] = leaf;
+  boxes[object] = box;
+  insertLeaf(leaf);
+  moved.push_back(object);
+}
+
+void DynamicTree::remove(size_t object) {
+  int leaf = leaves[object];
+  assert(leaf >= 0);
+  removeLeaf(leaf);
+  releaseNode(leaf);
+  leaves[object] = -1;
+}
+
+bool DynamicTree::move(size_t object, const Eigen::AlignedBox3f &box) {
+  int leaf = leaves[object];
+  boxes[object] = box;
+  if (nodes[leaf].box.contains(box))
+    return false;
+  removeLeaf(leaf);
+  Eigen::Vector3f fat = Eigen::Vector3f::Constant(margin);
+  nodes[leaf].box = Eigen::AlignedBox3f(box.min() - fat, box.max() + fat);
+  insertLeaf(leaf);
+  moved.push_back(object);
+  return true;
+}
+
+void DynamicTree::insertLeaf(int leaf) {
+  if (root < 0) {
+    root = leaf;
+    nodes[root].parent = -1;
+    return;
+  }
+
+  // Go down to the sibling, where the new leaf adds the least surface to the
+  // tree. Every node above the sibling grows by the box of the leaf.
+  const Eigen::AlignedBox3f box = nodes[leaf].box;
+  int sibling = root;
+  while (!nodes[sibling].isLeaf()) {
+    const Node &node = nodes[sibling];
+    float combined = area(node.box.merged(box));
+    // Cost of a new parent for this node and the leaf.
+    float cost = 2.0f * combined;
+    // Cost, which is added to all nodes below.
+    float inherited = 2.0f * (combined - area(node.box));
+
+    float childCost[2];
+    int children[2] = {node.left, node.right};
+    for (int i = 0; i < 2; ++i) {
+      const Node &child = nodes[children[i]];
+      childCost[i] = area(child.box.merged(box)) + inherited;
+      if (!child.isLeaf())
+        childCost[i] -= area(child.box);
+    }
+    if (cost < childCost[0] && cost < childCost[1])
+      break;
+    sibling = childCost[0] < childCost[1] ? children[0] : children[1];
+  }
+
+  int oldParent = nodes[sibling].parent;
+  int parent = allocateNode();
+  nodes[parent].parent = oldParent;
+  nodes[parent].left = sibling;
+  nodes[parent].right = leaf;
+  nodes[sibling].parent = parent;
+  nodes[leaf].parent = parent;
+  if (oldParent < 0)
+    root = parent;
+  else if (nodes[oldParent].left == sibling)
+    nodes[oldParent].left = parent;
+  else
+    nodes[oldParent].right = parent;
+
+  for (int node = parent; node >= 0; node = nodes[node].parent) {
+    node = balance(node);
+    refit(node);
+  }
+}
+
+void DynamicTree::removeLeaf(int leaf) {
+  if (leaf == root) {
+    root = -1;
+    return;
+  }
+
+  // The sibling takes the place of the parent.
+  int parent = nodes[leaf].parent;
+  int grandParent = nodes[parent].parent;
+  int sibling =
+      nodes[parent].left == leaf ? nodes[parent].right : nodes[parent].left;
+  nodes[sibling].parent = grandParent;
+  if (grandParent < 0)
+    root = sibling;
+  else if (nodes[grandParent].left == parent)
+    nodes[grandParent].left = sibling;
+  else
+    nodes[grandParent].right = sibling;
+  releaseNode(parent);
+
+  for (int node = grandParent; node >= 0; node = nodes[node].parent) {
+    node = balance(node);
+    refit(node);
+  }
+}
+
+void DynamicTree::refit(int node) {
+  Node &n = nodes[node];
+  const Node &left = nodes[n.left];
+  const Node &right = nodes[n.right];
+  n.box = left.box.merged(right.box);
+  n.height = 1 + max(left.height, right.height);
+}
+
+int DynamicTree::balance(int node) {
+  const Node &n = nodes[node];
+  if (n.isLeaf() || n.height < 2)
+    return node;
+  int difference = nodes[n.right].height - nodes[n.left].height;
+  if (difference > 1)
+    return rotate(node, n.right);
+  if (difference < -1)
+    return rotate(node, n.left);
+  return node;
+}
+
+int DynamicTree::rotate(int a, int c) {
+  Node &nodeA = nodes[a];
+  Node &nodeC = nodes[c];
+  int f = nodeC.left;
+  int g = nodeC.right;
+
+  nodeC.parent = nodeA.parent;
+  nodeA.parent = c;
+  if (nodeC.parent < 0)
+    root = c;
+  else if (nodes[nodeC.parent].left == a)
+    nodes[nodeC.parent].left = c;
+  else
+    nodes[nodeC.parent].right = c;
+
+  // The higher child of 'c' stays below it, the other one moves to 'a'.
+  int keep = nodes[f].height > nodes[g].height ? f : g;
+  int give = keep == f ? g : f;
+  nodeC.left = a;
+  nodeC.right = keep;
+  if (nodeA.left == c)
+    nodeA.left = give;
+  else
+    nodeA.right = give;
+  nodes[give].parent = a;
+
+  refit(a);
+  refit(c);
+  return c;
+}
+
+template <typename Visit>
+void DynamicTree::visitLeaves(const Eigen::AlignedBox3f &region,
+                              Visit visit) const {
+  if (root < 0)
+    return;
+  vector<int> stack(1, root);
+  while (!stack.empty()) {
+    const Node &node = nodes[stack.back()];
+    stack.pop_back();
+    if (!node.box.intersects(region))
+      continue;
+    if (node.isLeaf()) {
+      visit(node.object);
+    } else {
+      stack.push_back(node.left);
+      stack.push_back(node.right);
+    }
+  }
+}
+
+void DynamicTree::updatePairs() {
+  // Pairs of objects which did not move keep overlapping, the others are
+  // tested again.
+  vector<Pair> found;
+  for (auto it = candidates.begin(); it != candidates.end(); ++it) {
+    if (it->first >= leaves.size() || it->second >= leaves.size())
+      continue;
+    int a = leaves[it->first], b = leaves[it->second];
+    if (a >= 0 && b >= 0 && nodes[a].box.intersects(nodes[b].box))
+      found.push_back(*it);
+  }
+  // New overlaps need at least one moved object.
+  for (auto it = moved.begin(); it != moved.end(); ++it) {
+    size_t object = *it;
+    if (object >= leaves.size() || leaves[object] < 0)
+      continue;
+    visitLeaves(nodes[leaves[object]].box, [&](size_t other) {
+      if (other != object)
+        found.push_back(Pair(min(object, other), max(object, other)));
+    });
+  }
+  moved.clear();
+  sort(found.begin(), found.end());
+  found.erase(unique(found.begin(), found.end()), found.end());
+  candidates.swap(found);
+
+  pairs.clear();
+  for (auto it = candidates.begin(); it != candidates.end(); ++it) {
+    if (boxes[it->first].intersects(boxes[it->second]))
+      pairs.push_back(*it);
+  }
+}
+
+void DynamicTree::update(const vector<Eigen::AlignedBox3f> &bounds) {
+  for (size_t i = bounds.size(); i < leaves.size(); ++i) {
+    if (leaves[i] >= 0)
+      remove(i);
+  }
+  if (leaves.size() > bounds.size()) {
+    leaves.resize(bounds.size());
+    boxes.resize(bounds.size());
+  }
+  for (size_t i = 0; i < bounds.size(); ++i) {
+    if (i < leaves.size() && leaves[i] >= 0)
+      move(i, bounds[i]);
+    else
+      insert(i, bounds[i]);
+  }
+  updatePairs();
+}
+
+void DynamicTree::query(const Eigen::AlignedBox3f &region,
+                        vector<size_t> &objects) const {
+  visitLeaves(region, [&](size_t object) {
+    if (boxes[object].intersects(region))
+      objects.push_back(object);
+  });
+}
+
+void DynamicTree::rayCast(const Eigen::Vector3f &origin,
+                          const Eigen::Vector3f &direction, float maxDistance,
+                          vector<size_t> &objects) const {
+  // Slab test: the ray is in a box between the largest entry and the smallest
+  // exit distance of the three axes. Like in query(), the faces belong to the
+  // box. A ray parallel to an axis never enters or exits its slab, it is
+  // either always or never between both faces.
+  auto hit = [&](const Eigen::AlignedBox3f &box) {
+    float enter = 0.0f, exit = maxDistance;
+    for (int i = 0; i < 3; ++i) {
+      if (direction[i] == 0.0f) {
+        if (origin[i] < box.min()[i] || origin[i] > box.max()[i])
+          return false;
+        continue;
+      }
+      float t0 = (box.min()[i] - origin[i]) / direction[i];
+      float t1 = (box.max()[i] - origin[i]) / direction[i];
+      enter = max(enter, min(t0, t1));
+      exit = min(exit, max(t0, t1));
+    }
+    return enter <= exit;
+  };
+
+  if (root < 0)
+    return;
+  vector<int> stack(1, root);
+  while (!stack.empty()) {
+    const Node &node = nodes[stack.back()];
+    stack.pop_back();
+    if (!hit(node.box))
+      continue;
+    if (node.isLeaf()) {
+      if (hit(boxes[node.object]))
+        objects.push_back(node.object);
+    } else {
+      stack.push_back(node.left);
+      stack.push_back(node.right);
+    }
+  }
+}
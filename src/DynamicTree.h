@@ -0,0 +1,102 @@
+//
+//  DynamicTree.h
+//  SphereOctree
+//
+
+#ifndef DynamicTree_h
+#define DynamicTree_h
+
+#include "Broadphase.h"
+
+// A binary tree of axis aligned boxes over all objects of the world. Each leaf
+// stores the box of one object, enlarged by a margin, so the leaf only has to
+// be moved in the tree once the object leaves this fat box. Objects which do
+// not move, like large static ones, never change the tree. New leaves are put
+// next to the node, which grows the least, and the tree is kept balanced by
+// rotations. Besides the overlapping pairs, the tree answers ray and region
+// queries over the world.
+class DynamicTree : public Broadphase {
+  struct Node {
+    Eigen::AlignedBox3f box;
+    int parent;
+    int left;
+    int right;
+    // 0 for leaves, -1 for unused nodes.
+    int height;
+    size_t object;
+    inline bool isLeaf() const { return left < 0; }
+  };
+
+  float margin;
+  std::vector<Node> nodes;
+  int root = -1;
+  // Unused nodes, linked by their parent index.
+  int freeNodes = -1;
+  // Leaf of each object, -1 if the object is not in the tree.
+  std::vector<int> leaves;
+  // Boxes of the objects without margin.
+  std::vector<Eigen::AlignedBox3f> boxes;
+  // Objects, whose leaves were inserted since the last updatePairs().
+  std::vector<size_t> moved;
+  // Pairs whose fat boxes overlap.
+  std::vector<Pair> candidates;
+  std::vector<Pair> pairs;
+
+  int allocateNode();
+  void releaseNode(int node);
+  void insertLeaf(int leaf);
+  void removeLeaf(int leaf);
+
+  // Sets the box and height of an inner node from its children.
+  void refit(int node);
+
+  // Rotates the higher child up, if the heights of the children differ by more
+  // than one. Returns the node now at this place.
+  int balance(int node);
+
+  // Moves child 'c' of node 'a' to the place of 'a'. Returns 'c'.
+  int rotate(int a, int c);
+
+  // Calls 'visit' for the object of each leaf, whose fat box overlaps the
+  // region.
+  template <typename Visit>
+  void visitLeaves(const Eigen::AlignedBox3f &region, Visit visit) const;
+
+public:
+  // @arg margin: Distance by which the boxes in the tree are enlarged
+  explicit DynamicTree(float margin = 0.1f);
+
+  // Adds an object to the tree.
+  // @arg object: Index of the object
+  // @arg box: Bounding box of the object
+  void insert(size_t object, const Eigen::AlignedBox3f &box);
+
+  // Removes an object from the tree.
+  void remove(size_t object);
+
+  // Sets the box of an object. Returns true, if the object left its fat box
+  // and its leaf was moved in the tree.
+  bool move(size_t object, const Eigen::AlignedBox3f &box);
+
+  // Finds the overlapping pairs after objects were inserted, removed or moved.
+  // Only the moved objects are searched in the tree.
+  void updatePairs();
+
+  // Inserts, moves and removes objects to match the boxes, and updates the
+  // pairs.
+  void update(const std::vector<Eigen::AlignedBox3f> &bounds);
+  inline const std::vector<Pair> &getPairs() const { return pairs; }
+
+  // Appends the objects whose boxes overlap the region.
+  void query(const Eigen::AlignedBox3f &region,
+             std::vector<size_t> &objects) const;
+
+  // Appends the objects whose boxes are hit by the ray within 'maxDistance'.
+  // @arg origin: Start of the ray
+  // @arg direction: Direction of the ray, the distance is measured in its
+  //                 length
+  void rayCast(const Eigen::Vector3f &origin, const Eigen::Vector3f &direction,
+               float maxDistance, std::vector<size_t> &objects) const;
+};
+
+#endif /* DynamicTree_h */
@@ -0,0 +1,31 @@
+//
+//  Frustum.cpp
+//  SphereOctree
+//
+
+#include "Frustum.h"
+
+Frustum::Frustum(const Eigen::Matrix4f &clip) {
+  // A point is in the frustum, if -w <= x, y, z <= w in clip coordinates,
+  // which gives one plane for each side of each inequality.
+  Eigen::Vector4f w = clip.row(3).transpose();
+  for (int i = 0; i < 3; ++i) {
+    planes[2 * i] = w + clip.row(i).transpose();
+    planes[2 * i + 1] = w - clip.row(i).transpose();
+  }
+  for (int i = 0; i < 6; ++i)
+    planes[i] /= planes[i].head<3>().norm();
+}
+
+Frustum::Result Frustum::test(const Eigen::Vector3f &center,
+                              float radius) const {
+  Result result = INSIDE;
+  for (int i = 0; i < 6; ++i) {
+    float distance = planes[i].head<3>().dot(center) + planes[i](3);
+    if (distance < -radius)
+      return OUTSIDE;
+    if (distance < radius)
+      result = INTERSECTS;
+  }
+  return result;
+}
@@ -0,0 +1,33 @@
+//
+//  Frustum.h
+//  SphereOctree
+//
+
+#ifndef Frustum_h
+#define Frustum_h
+
+#define EIGEN_DONT_ALIGN_STATICALLY
+#include <Eigen/Dense>
+
+// The six planes of a view frustum, to skip spheres which can not be seen.
+class Frustum {
+  // Each plane (a, b, c, d) has a unit normal (a, b, c) which points into the
+  // frustum, so a x + b y + c z + d is the distance of a point to the plane.
+  Eigen::Vector4f planes[6];
+
+public:
+  enum Result { OUTSIDE, INTERSECTS, INSIDE };
+
+  // Extracts the planes from a projection matrix.
+  // @arg clip: Projection times model view matrix. The planes are in the space
+  //            which the model view matrix is applied to, e.g. object space.
+  explicit Frustum(const Eigen::Matrix4f &clip);
+
+  // Returns whether a sphere is outside of the frustum, intersects one of its
+  // planes or is completely inside.
+  // @arg center: Center of the sphere
+  // @arg radius: Radius of the sphere
+  Result test(const Eigen::Vector3f &center, float radius) const;
+};
+
+#endif /* Frustum_h */
@@ -0,0 +1,126 @@
+#include "Mesh.h"
+#include <cmath>
+#include <iostream>
+
+#define TINYOBJLOADER_IMPLEMENTATION
+#include "tiny_obj_loader.h"
+
+using namespace std;
+
+Mesh::Mesh() {}
+
+Mesh::~Mesh() {}
+
+bool Mesh::loadMesh(const string &meshName) {
+  // Load geometry
+  // Some obj files contain material information.
+  // We'll ignore them for this assignment.
+  vector<tinyobj::shape_t> shapes;
+  vector<tinyobj::material_t> objMaterials;
+  string errStr;
+  bool rc = tinyobj::LoadObj(shapes, objMaterials, errStr, meshName.c_str());
+  if (!rc) {
+    cerr << errStr << endl;
+    return false;
+  }
+  if (shapes.empty() || shapes[0].mesh.positions.empty()) {
+    cerr << "No vertices in file [" << meshName << "]" << endl;
+    return false;
+  }
+  posBuf = shapes[0].mesh.positions;
+  norBuf = shapes[0].mesh.normals;
+  texBuf = shapes[0].mesh.texcoords;
+  eleBuf = shapes[0].mesh.indices;
+  return true;
+}
+
+void Mesh::createSphere(int rings, int segments) {
+  posBuf.clear();
+  norBuf.clear();
+  texBuf.clear();
+  eleBuf.clear();
+  // One vertex per ring and segment. The first and last segment meet at the
+  // same positions, but with other texture coordinates.
+  for (int r = 0; r <= rings; ++r) {
+    float theta = (float)M_PI * r / rings;
+    for (int s = 0; s <= segments; ++s) {
+      float phi = 2.0f * (float)M_PI * s / segments;
+      Eigen::Vector3f n(sin(theta) * cos(phi), cos(theta),
+                        -sin(theta) * sin(phi));
+      for (int i = 0; i < 3; ++i) {
+        posBuf.push_back(0.5f * n(i));
+        norBuf.push_back(n(i));
+      }
+      texBuf.push_back((float)s / segments);
+      texBuf.push_back(1.0f - (float)r / rings);
+    }
+  }
+  // Two triangles per quad, one at the poles.
+  for (int r = 0; r < rings; ++r) {
+    for (int s = 0; s < segments; ++s) {
+      unsigned a = r * (segments + 1) + s;
+      unsigned b = a + segments + 1;
+      if (r != 0) {
+        eleBuf.push_back(a);
+        eleBuf.push_back(b);
+        eleBuf.push_back(a + 1);
+      }
+      if (r != rings - 1) {
+        eleBuf.push_back(a + 1);
+        eleBuf.push_back(b);
+        eleBuf.push_back(b + 1);
+      }
+    }
+  }
+}
+
+void Mesh::fitToUnitBox() {
+  // Scale the vertex positions so that they fit within [-1, +1] in all three
+  // dimensions.
+  if (posBuf.empty())
+    return;
+  Eigen::Vector3f vmin(posBuf[0], posBuf[1], posBuf[2]);
+  Eigen::Vector3f vmax(posBuf[0], posBuf[1], posBuf[2]);
+  for (int i = 0; i < (int)posBuf.size(); i += 3) {
+    Eigen::Vector3f v(posBuf[i], posBuf[i + 1], posBuf[i + 2]);
+    vmin(0) = min(vmin(0), v(0));
+    vmin(1) = min(vmin(1), v(1));
+    vmin(2) = min(vmin(2), v(2));
+    vmax(0) = max(vmax(0), v(0));
+    vmax(1) = max(vmax(1), v(1));
+    vmax(2) = max(vmax(2), v(2));
+  }
+  Eigen::Vector3f center = 0.5f * (vmin + vmax);
+  Eigen::Vector3f diff = vmax - vmin;
+  float diffmax = diff(0);
+  diffmax = max(diffmax, diff(1));
+  diffmax = max(diffmax, diff(2));
+  float scale = 1.0f / diffmax;
+  for (int i = 0; i < (int)posBuf.size(); i += 3) {
+    posBuf[i] = (posBuf[i] - center(0)) * scale;
+    posBuf[i + 1] = (posBuf[i + 1] - center(1)) * scale;
+    posBuf[i + 2] = (posBuf[i + 2] - center(2)) * scale;
+  }
+}
+
+shared_ptr<vector<shared_ptr<Eigen::Vector3f>>> Mesh::getPositions() const {
+  shared_ptr<vector<shared_ptr<Eigen::Vector3f>>> positions =
+      make_shared<vector<shared_ptr<Eigen::Vector3f>>>();
+  for (size_t i = 0; i < posBuf.size(); i += 3) {
+    positions->push_back(make_shared<Eigen::Vector3f>(
+        posBuf.at(i), posBuf.at(i + 1), posBuf.at(i + 2)));
+  }
+  return positions;
+}
+
+shared_ptr<vector<shared_ptr<Face>>> Mesh::getFaces() const {
+  shared_ptr<vector<shared_ptr<Eigen::Vector3f>>> positions = getPositions();
+  shared_ptr<vector<shared_ptr<Face>>> faces =
+      make_shared<vector<shared_ptr<Face>>>();
+  for (size_t i = 0; i < eleBuf.size(); i += 3) {
+    faces->push_back(make_shared<Face>(positions->at(eleBuf[i]),
+                                       positions->at(eleBuf[i + 1]),
+                                       positions->at(eleBuf[i + 2])));
+  }
+  return faces;
+}
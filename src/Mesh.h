@@ -0,0 +1,48 @@
+#pragma once
+#ifndef _MESH_H_
+#define _MESH_H_
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#define EIGEN_DONT_ALIGN_STATICALLY
+#include <Eigen/Dense>
+
+struct Face {
+  std::shared_ptr<Eigen::Vector3f> a, b, c;
+
+  Face(std::shared_ptr<Eigen::Vector3f> _a, std::shared_ptr<Eigen::Vector3f> _b,
+       std::shared_ptr<Eigen::Vector3f> _c)
+      : a(_a), b(_b), c(_c) {}
+};
+
+// The geometry of a mesh, loaded from an obj file. It does not need OpenGL, so
+// meshes can be loaded and used for collision detection without a window.
+class Mesh {
+public:
+  Mesh();
+  virtual ~Mesh();
+  // Loads the first shape of an obj file. Returns false and leaves the mesh
+  // unchanged, if the file can not be read or has no vertices.
+  bool loadMesh(const std::string &meshName);
+  // Creates a sphere with radius 0.5 around the origin, like a sphere fitted
+  // by fitToUnitBox(), with 2 * (rings - 1) * segments triangles.
+  // @arg rings: Number of rings from pole to pole (at least 2)
+  // @arg segments: Number of segments around the poles (at least 3)
+  void createSphere(int rings, int segments);
+  // Scales and moves the vertices into [-1, 1]. Does nothing for an empty
+  // mesh.
+  void fitToUnitBox();
+  std::shared_ptr<std::vector<std::shared_ptr<Eigen::Vector3f>>>
+  getPositions() const;
+  std::shared_ptr<std::vector<std::shared_ptr<Face>>> getFaces() const;
+
+protected:
+  std::vector<unsigned int> eleBuf;
+  std::vector<float> posBuf;
+  std::vector<float> norBuf;
+  std::vector<float> texBuf;
+};
+
+#endif
@@ -0,0 +1,231 @@
+//
+//  ObjectRenderer.cpp
+//  SphereOctree
+//
+
+#include "ObjectRenderer.h"
+#include <algorithm>
+#include <limits>
+
+using namespace std;
+
+ObjectRenderer::ObjectRenderer(shared_ptr<Shape> objShape,
+                               shared_ptr<Shape> sphereShape,
+                               shared_ptr<Program> sProg,
+                               shared_ptr<Program> oProg,
+                               shared_ptr<Program> tProg, bool *keyToo)
+    : shape(objShape), sphere(sphereShape), shapeProg(sProg), octreeProg(oProg),
+      transProg(tProg), keyToogles(keyToo), shapeUniforms(*sProg),
+      octreeUniforms(*oProg), transUniforms(*tProg),
+      octreeT(oProg->getUniform("T")), instanced(GLEW_VERSION_3_3),
+      levels(TREE_DEEPNESS + 1) {}
+
+ObjectRenderer::~ObjectRenderer() {
+  for (auto it = levels.begin(); it != levels.end(); ++it) {
+    if (it->bufID != 0)
+      glDeleteBuffers(1, &it->bufID);
+  }
+  if (colliding.bufID != 0)
+    glDeleteBuffers(1, &colliding.bufID);
+  if (visible.bufID != 0)
+    glDeleteBuffers(1, &visible.bufID);
+}
+
+void ObjectRenderer::addSphereLod(shared_ptr<Shape> lodShape,
+                                  float maxPixels) {
+  SphereLod lod;
+  lod.shape = lodShape;
+  lod.maxPixels = maxPixels;
+  auto it = lods.begin();
+  while (it != lods.end() && it->maxPixels < maxPixels)
+    ++it;
+  lods.insert(it, lod);
+}
+
+void ObjectRenderer::draw(const WorldObject &obj, const ObjectSnapshot &state,
+                          shared_ptr<Camera> camera) const {
+  auto MV = make_shared<MatrixStack>();
+  auto P = make_shared<MatrixStack>();
+  camera->applyProjectionMatrix(P);
+  camera->applyViewMatrix(MV);
+
+  MV->pushMatrix();
+  MV->multMatrix(state.transform);
+
+  // The frustum is in object space, so the spheres of the octree are tested
+  // without transforming them. The mesh is in the sphere of the root.
+  Frustum frustum(P->topMatrix() * MV->topMatrix());
+  const OctreeNode &root = *obj.getOctree();
+  if (reaches.empty())
+    computeReach(root, reaches);
+  Frustum::Result visibility =
+      frustum.test(*root.getOrigin(), reaches[root.getId()]);
+  if (visibility == Frustum::OUTSIDE)
+    return;
+
+  // Spheres are projected largest at the nearest point of the octree.
+  GLint viewport[4];
+  glGetIntegerv(GL_VIEWPORT, viewport);
+  Eigen::Vector3f center = MV->topMatrix().topLeftCorner<3, 3>() *
+                               *root.getOrigin() +
+                           MV->topMatrix().topRightCorner<3, 1>();
+  float depth = -center.z() - reaches[root.getId()];
+  float pixelsPerUnit = depth > 0.0f
+                            ? P->topMatrix()(1, 1) * 0.5f * viewport[3] / depth
+                            : numeric_limits<float>::infinity();
+
+  if (frustum.test(*root.getOrigin(), root.getRadius()) != Frustum::OUTSIDE) {
+    shapeProg->bind();
+    glUniformMatrix4fv(shapeUniforms.P, 1, GL_FALSE, P->topMatrix().data());
+    glUniformMatrix4fv(shapeUniforms.MV, 1, GL_FALSE, MV->topMatrix().data());
+    shape->draw();
+    shapeProg->unbind();
+  }
+
+  // Draw all spheres on level
+  if (keyToogles[(unsigned)'s']) {
+    int level = 1;
+    for (int i = 0; i < 9; ++i) {
+      if (keyToogles[(unsigned)'1' + i])
+        level += i;
+    }
+    if (keyToogles[(unsigned)'0'])
+      level = TREE_DEEPNESS;
+    transProg->bind();
+    glUniformMatrix4fv(transUniforms.P, 1, GL_FALSE, P->topMatrix().data());
+    glUniformMatrix4fv(transUniforms.MV, 1, GL_FALSE, MV->topMatrix().data());
+    if (visibility == Frustum::INSIDE) {
+      if (level >= (int)levels.size())
+        levels.resize(level + 1);
+      Instances &instances = levels[level];
+      if (instances.data.empty()) {
+        addLevel(root, level, instances.data);
+        upload(instances, GL_STATIC_DRAW);
+      }
+      drawSpheres(instances, pixelsPerUnit);
+    } else {
+      visible.data.clear();
+      addVisibleLevel(root, level, frustum, visible.data);
+      upload(visible, GL_STREAM_DRAW);
+      drawSpheres(visible, pixelsPerUnit);
+    }
+    transProg->unbind();
+  }
+  // Draw colliding spheres only
+  else {
+    octreeProg->bind();
+    glUniformMatrix4fv(octreeUniforms.P, 1, GL_FALSE, P->topMatrix().data());
+    Eigen::Matrix3f T;
+    T(0) = TREE_DEEPNESS;
+    T(4) = TREE_DEEPNESS;
+    glUniformMatrix3fv(octreeT, 1, GL_FALSE, T.data());
+    glUniformMatrix4fv(octreeUniforms.MV, 1, GL_FALSE, MV->topMatrix().data());
+    colliding.data.clear();
+    const vector<size_t> &nodes = state.collidingNodes;
+    for (auto it = nodes.begin(); it != nodes.end(); ++it) {
+      const OctreeNode &node = obj.getNode(*it);
+      if (frustum.test(*node.getOrigin(), node.getRadius()) !=
+          Frustum::OUTSIDE)
+        addNode(node, colliding.data);
+    }
+    upload(colliding, GL_STREAM_DRAW);
+    drawSpheres(colliding, pixelsPerUnit);
+    octreeProg->unbind();
+  }
+
+  MV->popMatrix();
+}
+
+void ObjectRenderer::addNode(const OctreeNode &node, vector<float> &instances) {
+  const Eigen::Vector3f &origin = *node.getOrigin();
+  instances.push_back(origin.x());
+  instances.push_back(origin.y());
+  instances.push_back(origin.z());
+  instances.push_back(node.getScale());
+}
+
+void ObjectRenderer::addLevel(const OctreeNode &node, size_t level,
+                              vector<float> &instances) {
+  if (--level == 0) {
+    addNode(node, instances);
+  } else {
+    auto children = node.getChildren();
+    for (auto it = children->begin(); it != children->end(); ++it)
+      addLevel(**it, level, instances);
+  }
+}
+
+float ObjectRenderer::computeReach(const OctreeNode &node,
+                                  vector<float> &reaches) {
+  float reach = node.getRadius();
+  auto children = node.getChildren();
+  for (auto it = children->begin(); it != children->end(); ++it) {
+    float childReach = computeReach(**it, reaches);
+    reach = max(reach, (*(*it)->getOrigin() - *node.getOrigin()).norm() +
+                           childReach);
+  }
+  if (node.getId() >= reaches.size())
+    reaches.resize(node.getId() + 1);
+  reaches[node.getId()] = reach;
+  return reach;
+}
+
+void ObjectRenderer::addVisibleLevel(const OctreeNode &node, size_t level,
+                                     const Frustum &frustum,
+                                     vector<float> &instances) const {
+  float radius = level == 1 ? node.getRadius() : reaches[node.getId()];
+  Frustum::Result result = frustum.test(*node.getOrigin(), radius);
+  if (result == Frustum::OUTSIDE)
+    return;
+  if (result == Frustum::INSIDE) {
+    addLevel(node, level, instances);
+  } else if (--level == 0) {
+    addNode(node, instances);
+  } else {
+    auto children = node.getChildren();
+    for (auto it = children->begin(); it != children->end(); ++it)
+      addVisibleLevel(**it, level, frustum, instances);
+  }
+}
+
+void ObjectRenderer::upload(Instances &instances, GLenum usage) const {
+  instances.maxScale = 0.0f;
+  for (size_t i = 3; i < instances.data.size(); i += 4)
+    instances.maxScale = max(instances.maxScale, instances.data[i]);
+  if (!instanced || instances.data.empty())
+    return;
+  if (instances.bufID == 0)
+    glGenBuffers(1, &instances.bufID);
+  glBindBuffer(GL_ARRAY_BUFFER, instances.bufID);
+  glBufferData(GL_ARRAY_BUFFER, instances.data.size() * sizeof(float),
+               &instances.data[0], usage);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+shared_ptr<Shape> ObjectRenderer::chooseSphere(float pixels) const {
+  for (auto it = lods.begin(); it != lods.end(); ++it) {
+    if (pixels < it->maxPixels)
+      return it->shape;
+  }
+  return sphere;
+}
+
+void ObjectRenderer::drawSpheres(const Instances &instances,
+                                 float pixelsPerUnit) const {
+  int count = (int)instances.data.size() / 4;
+  if (count == 0)
+    return;
+  // The scale is the diameter of a sphere.
+  shared_ptr<Shape> lodShape =
+      chooseSphere(0.5f * instances.maxScale * pixelsPerUnit);
+  if (instanced) {
+    lodShape->drawInstanced(instances.bufID, count);
+  } else {
+    // Without an instance buffer, the attribute keeps the value set here for
+    // all vertices of the next draw call.
+    for (int i = 0; i < count; ++i) {
+      glVertexAttrib4fv(Program::INST, &instances.data[4 * i]);
+      lodShape->draw();
+    }
+  }
+}
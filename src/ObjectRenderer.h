@@ -0,0 +1,137 @@
+//
+//  ObjectRenderer.h
+//  SphereOctree
+//
+
+#ifndef ObjectRenderer_h
+#define ObjectRenderer_h
+
+#include "Camera.h"
+#include "Frustum.h"
+#include "MatrixStack.h"
+#include "Program.h"
+#include "Shape.h"
+#include "Simulation.h"
+#include "WorldObject.h"
+#include <memory>
+#include <vector>
+
+// Draws a world object with OpenGL: its shape, and either its colliding
+// spheres or all spheres on a level of its octree. The spheres are drawn with
+// one instanced draw call; each instance is the center and scale of a sphere.
+// Objects and spheres outside of the view frustum are skipped, whole subtrees
+// of the octree at once. Spheres which cover only a few pixels are drawn with
+// a coarser sphere shape.
+class ObjectRenderer {
+  // Spheres to draw: 4 floats per sphere and the buffer they are sent to.
+  struct Instances {
+    std::vector<float> data;
+    unsigned bufID = 0;
+    // Largest scale of the instances.
+    float maxScale = 0.0f;
+  };
+  // A coarse sphere shape and the largest projected radius in pixels, for
+  // which it is drawn.
+  struct SphereLod {
+    std::shared_ptr<Shape> shape;
+    float maxPixels;
+  };
+
+  std::shared_ptr<Shape> shape;
+  std::shared_ptr<Shape> sphere;
+  // Coarser spheres, sorted by maxPixels.
+  std::vector<SphereLod> lods;
+  std::shared_ptr<Program> shapeProg;
+  std::shared_ptr<Program> octreeProg;
+  std::shared_ptr<Program> transProg;
+  bool *keyToogles;
+  // Handles of the uniforms of a program, looked up once instead of by name
+  // for each frame.
+  struct Uniforms {
+    GLint P;
+    GLint MV;
+    explicit Uniforms(const Program &prog)
+        : P(prog.getUniform("P")), MV(prog.getUniform("MV")) {}
+  };
+  Uniforms shapeUniforms;
+  Uniforms octreeUniforms;
+  Uniforms transUniforms;
+  // Texture transform of octreeProg.
+  GLint octreeT;
+  // If false, the OpenGL version has no instanced drawing, and the spheres
+  // are drawn one by one.
+  bool instanced;
+  // The spheres of each level do not change, so they are sent to the GPU once
+  // per level. The colliding spheres are sent again each frame.
+  mutable std::vector<Instances> levels;
+  mutable Instances colliding;
+  // Visible spheres of a level, if the object is only partly visible. They are
+  // sent again each frame.
+  mutable Instances visible;
+  // Radius around the origin of each node, indexed by its id, which contains
+  // the sphere of the node and the spheres of all nodes below it. A child
+  // sphere can reach out of the sphere of its parent, so the sphere of a node
+  // alone does not bound its subtree.
+  mutable std::vector<float> reaches;
+
+  // Computes the reach of a node and all nodes below it and returns it.
+  static float computeReach(const OctreeNode &node,
+                            std::vector<float> &reaches);
+
+  // Appends the sphere of a node to the instances.
+  static void addNode(const OctreeNode &node, std::vector<float> &instances);
+
+  // Appends all spheres on the given level below a node (starts with 1).
+  static void addLevel(const OctreeNode &node, size_t level,
+                       std::vector<float> &instances);
+
+  // Appends the spheres on the given level below a node, which are not
+  // outside of the frustum. Subtrees outside of it are skipped.
+  void addVisibleLevel(const OctreeNode &node, size_t level,
+                       const Frustum &frustum,
+                       std::vector<float> &instances) const;
+
+  // Sends the instances to their buffer and updates their largest scale.
+  void upload(Instances &instances, GLenum usage) const;
+
+  // Returns the coarsest sphere shape, which is fine enough for a sphere
+  // with the given projected radius.
+  std::shared_ptr<Shape> chooseSphere(float pixels) const;
+
+  // Draws a sphere for each instance with the bound program. All instances
+  // use the same sphere shape, chosen for the largest one.
+  // @arg pixelsPerUnit: Projected size of a unit at the distance of the
+  //                     nearest point of the object
+  void drawSpheres(const Instances &instances, float pixelsPerUnit) const;
+
+public:
+  // @arg shape: Shape of the object
+  // @arg sphere: Sphere shape
+  // @arg shapeProg: Program for drawing the object shape
+  // @arg octreeProg: Program for drawing the colliding spheres in the octree
+  // @arg transProg: Program for drawing all spheres on a level in the octree
+  // @arg keyToogles: Pointer to [bool] key toogles
+  // Both sphere programs take the instances in the attribute "aInst".
+  ObjectRenderer(std::shared_ptr<Shape> shape, std::shared_ptr<Shape> sphere,
+                 std::shared_ptr<Program> shapeProg,
+                 std::shared_ptr<Program> octreeProg,
+                 std::shared_ptr<Program> transProg, bool *keyToogles);
+  virtual ~ObjectRenderer();
+
+  // Adds a coarse sphere shape, which is drawn instead of the sphere for
+  // spheres with a projected radius of less than maxPixels.
+  // @arg shape: Sphere shape with radius 0.5, see Mesh::createSphere()
+  // @arg maxPixels: Largest projected radius in pixels
+  void addSphereLod(std::shared_ptr<Shape> shape, float maxPixels);
+
+  // Draws the object and the colliding spheres or all spheres on a level,
+  // depending on the keyToogles, if they are in the view of the camera. Only
+  // the octree of the object is used, which does not change, so the object
+  // can be simulated at the same time.
+  // @arg obj: The object to draw
+  // @arg state: Position and colliding leaves of the object
+  void draw(const WorldObject &obj, const ObjectSnapshot &state,
+            std::shared_ptr<Camera> camera) const;
+};
+
+#endif /* ObjectRenderer_h */
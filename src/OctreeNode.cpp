@@ -7,17 +7,25 @@
 //
 
 #include "OctreeNode.h"
+#include <algorithm>
 #include <cstdlib>
 #include <ctime>
 #include <iostream>
+#include <limits>
 #include <stdio.h>
 #include "Miniball.hpp"
+#include "TriangleIntersection.h"
 
 using namespace std;
 
-OctreeNode::OctreeNode(shared_ptr<BoundingBox> _bb, shared_ptr<vector<shared_ptr<Face>>> f, size_t deepness)
+// Nodes with at least this deepness create their child nodes in parallel.
+// Below, a subtree is too small to be worth a task.
+static const size_t PARALLEL_DEEPNESS = 4;
+
+OctreeNode::OctreeNode(shared_ptr<BoundingBox> _bb, shared_ptr<vector<shared_ptr<Face>>> f, size_t d,
+                       shared_ptr<ThreadPool> pool)
 : bb(_bb), children(make_shared<vector<shared_ptr<OctreeNode>>>())
-, faces(f) {
+, faces(f), deepness(d) {
     // After we split a BB, there can be some which have no more faces.
     if (faces->size() == 0)
         return;
@@ -60,14 +68,27 @@ OctreeNode::OctreeNode(shared_ptr<BoundingBox> _bb, shared_ptr<vector<shared_ptr
     sphereRadius = sqrt(mb.squared_radius());
 
     // Create children
-    if (--deepness > 0) {
+    if (d > 1) {
         shared_ptr<vector<shared_ptr<BoundingBox>>> newBBs = bb->split();
-        for (auto it = newBBs->begin(); it != newBBs->end(); ++it) {
-            auto newChild =
-            make_shared<OctreeNode>(*it, (*it)->facesIn(faces), deepness);
+        vector<shared_ptr<OctreeNode>> newChildren(newBBs->size());
+        auto createChild = [&](size_t i) {
+            auto newBB = newBBs->at(i);
+            newChildren[i] = make_shared<OctreeNode>(newBB, newBB->facesIn(faces),
+                                                     d - 1, pool);
+        };
+        if (pool != nullptr && d >= PARALLEL_DEEPNESS) {
+            pool->parallelFor(0, newBBs->size(), createChild);
+        } else {
+            for (size_t i = 0; i < newBBs->size(); ++i)
+                createChild(i);
+        }
+        for (auto it = newChildren.begin(); it != newChildren.end(); ++it) {
+            auto newChild = *it;
             // If child has no faces and therefore no sphere, do not add it
-            if (newChild->getOrigin() != nullptr)
+            if (newChild->getOrigin() != nullptr) {
+                newChild->parent = this;
                 children->push_back(newChild);
+            }
         }
     }
 }
@@ -93,43 +114,17 @@ float OctreeNode::eucDistance(shared_ptr<Eigen::Vector3f> x,
     return d;
 }
 
-void OctreeNode::drawColliding(shared_ptr<Program> p, shared_ptr<Shape> s,
-                               shared_ptr<MatrixStack> MV) {
-    // If this node / sphere is colliding, draw it.
-    if (isColliding) {
-        MV->pushMatrix();
-        MV->translate(*getOrigin());
-        MV->scale(getScale());
-        glUniformMatrix4fv(p->getUniform("MV"), 1, GL_FALSE,
-                           MV->topMatrix().data());
-        s->draw(p);
-        MV->popMatrix();
-    }
-    // Draw children (if they are colliding).
+void OctreeNode::index(vector<const OctreeNode *> &nodes) {
+    id = nodes.size();
+    nodes.push_back(this);
     for (auto it = children->begin(); it != children->end(); ++it)
-        (*it)->drawColliding(p, s, MV);
-}
-
-void OctreeNode::drawLevel(shared_ptr<Program> p, shared_ptr<Shape> s,
-                           size_t lvl, shared_ptr<MatrixStack> MV) {
-    if (--lvl == 0) {
-        MV->pushMatrix();
-        MV->translate(*getOrigin());
-        MV->scale(getScale());
-        glUniformMatrix4fv(p->getUniform("MV"), 1, GL_FALSE,
-                           MV->topMatrix().data());
-        s->draw(p);
-        MV->popMatrix();
-    } else {
-        for (auto it = children->begin(); it != children->end(); ++it)
-            (*it)->drawLevel(p, s, lvl, MV);
-    }
+        (*it)->index(nodes);
 }
 
-void OctreeNode::resetColliding() {
-    isColliding = false;
+void OctreeNode::collect(vector<const OctreeNode *> &nodes) const {
+    nodes.push_back(this);
     for (auto it = children->begin(); it != children->end(); ++it)
-        (*it)->resetColliding();
+        (*it)->collect(nodes);
 }
 
 size_t OctreeNode::getNumChildren() const {
@@ -143,34 +138,152 @@ size_t OctreeNode::getNumChildren() const {
     }
 }
 
-bool OctreeNode::checkCollision(
-                                shared_ptr<OctreeNode> n, std::shared_ptr<Eigen::Matrix4f> myPosition,
-                                std::shared_ptr<Eigen::Matrix4f> otherPosition) {
-    // Get the global midpoint of the sphere, by translating the object position
-    // with the local sphere position.
-    Eigen::Vector4f a =
-    (*myPosition * Eigen::Vector4f(sphereOrigin->x(), sphereOrigin->y(),
-                                   sphereOrigin->z(), 1.0f));
-    Eigen::Vector4f b = (*otherPosition *
-                         Eigen::Vector4f(n->getOrigin()->x(), n->getOrigin()->y(),
-                                         n->getOrigin()->z(), 1.0f));
-    auto myMidpoint = make_shared<Eigen::Vector3f>(a.x(), a.y(), a.z());
-    auto otherMidpoint = make_shared<Eigen::Vector3f>(b.x(), b.y(), b.z());
+bool OctreeNode::overlaps(const OctreeNode &n,
+                          const Eigen::Matrix4f &myPosition,
+                          const Eigen::Matrix4f &otherPosition) const {
+    // The same test as the one of the collision front and separation(), so
+    // they agree with checkCollision() even for spheres which just touch.
+    return distance(n, myPosition, otherPosition) <= 0.0f;
+}
+
+float OctreeNode::distance(const OctreeNode &n,
+                           const Eigen::Matrix4f &myPosition,
+                           const Eigen::Matrix4f &otherPosition) const {
+    Eigen::Vector3f a = myPosition.topLeftCorner<3, 3>() * *sphereOrigin +
+                        myPosition.topRightCorner<3, 1>();
+    Eigen::Vector3f b = otherPosition.topLeftCorner<3, 3>() * *n.sphereOrigin +
+                        otherPosition.topRightCorner<3, 1>();
+    return (a - b).norm() - sphereRadius - n.sphereRadius;
+}
+
+bool OctreeNode::facesIntersect(const OctreeNode &n,
+                                const Eigen::Matrix4f &myPosition,
+                                const Eigen::Matrix4f &otherPosition) const {
+    // Transform the vertices of both leaves into world space. Each column is
+    // one vertex, three consecutive columns are one face.
+    auto otherFaces = n.faces;
+    Eigen::Matrix3Xf mine(3, 3 * faces->size());
+    Eigen::Matrix3Xf other(3, 3 * otherFaces->size());
+    Eigen::Matrix3f myRot = myPosition.topLeftCorner<3, 3>();
+    Eigen::Vector3f myTrans = myPosition.topRightCorner<3, 1>();
+    Eigen::Matrix3f otherRot = otherPosition.topLeftCorner<3, 3>();
+    Eigen::Vector3f otherTrans = otherPosition.topRightCorner<3, 1>();
+    for (size_t i = 0; i < faces->size(); ++i) {
+        const Face &f = *faces->at(i);
+        mine.col(3 * i) = myRot * *f.a + myTrans;
+        mine.col(3 * i + 1) = myRot * *f.b + myTrans;
+        mine.col(3 * i + 2) = myRot * *f.c + myTrans;
+    }
+    for (size_t i = 0; i < otherFaces->size(); ++i) {
+        const Face &f = *otherFaces->at(i);
+        other.col(3 * i) = otherRot * *f.a + otherTrans;
+        other.col(3 * i + 1) = otherRot * *f.b + otherTrans;
+        other.col(3 * i + 2) = otherRot * *f.c + otherTrans;
+    }
+
+    // For each of our faces, get the signed plane distances of all vertices of
+    // the other leaf in one batch. Only face pairs where the other face
+    // touches or crosses our plane need the full triangle test.
+    Eigen::RowVectorXf dist(other.cols());
+    for (Eigen::Index i = 0; i < mine.cols(); i += 3) {
+        Eigen::Vector3f p0 = mine.col(i);
+        Eigen::Vector3f p1 = mine.col(i + 1);
+        Eigen::Vector3f p2 = mine.col(i + 2);
+        Eigen::Vector3f normal = (p1 - p0).cross(p2 - p0);
+        dist.noalias() = normal.transpose() * other;
+        dist.array() -= normal.dot(p0);
+        for (Eigen::Index j = 0; j < other.cols(); j += 3) {
+            float d0 = dist(j), d1 = dist(j + 1), d2 = dist(j + 2);
+            if ((d0 > 0.0f && d1 > 0.0f && d2 > 0.0f) ||
+                (d0 < 0.0f && d1 < 0.0f && d2 < 0.0f))
+                continue;
+            if (trianglesIntersect(p0, p1, p2, other.col(j), other.col(j + 1),
+                                   other.col(j + 2)))
+                return true;
+        }
+    }
+    return false;
+}
+
+float OctreeNode::separation(const OctreeNode &n,
+                             const Eigen::Matrix4f &myPosition,
+                             const Eigen::Matrix4f &otherPosition,
+                             const OctreeNode **myClosest,
+                             const OctreeNode **otherClosest) const {
+    float best = numeric_limits<float>::max();
+    findSeparation(n, myPosition, otherPosition,
+                   distance(n, myPosition, otherPosition), best, myClosest,
+                   otherClosest);
+    return max(best, 0.0f);
+}
+
+void OctreeNode::findSeparation(const OctreeNode &n,
+                                const Eigen::Matrix4f &myPosition,
+                                const Eigen::Matrix4f &otherPosition, float d,
+                                float &best, const OctreeNode **myClosest,
+                                const OctreeNode **otherClosest) const {
+    // All faces of a node are in its sphere, so the faces below this pair
+    // can not be closer than the spheres.
+    if (d >= best)
+        return;
+    if (children->size() == 0 && n.children->size() == 0) {
+        best = d;
+        if (myClosest != nullptr)
+            *myClosest = this;
+        if (otherClosest != nullptr)
+            *otherClosest = &n;
+        return;
+    }
+    // Like in checkCollision(), a leaf and an inner node never collide, since
+    // both trees are descended at the same time.
+    if (children->size() == 0 || n.children->size() == 0)
+        return;
+
+    // Visit the closest child pairs first, so the bound shrinks quickly.
+    typedef pair<float, pair<OctreeNode *, OctreeNode *>> ChildPair;
+    vector<ChildPair> childPairs;
+    childPairs.reserve(children->size() * n.children->size());
+    for (auto itMe = children->begin(); itMe != children->end(); ++itMe) {
+        for (auto itOther = n.children->begin(); itOther != n.children->end();
+             ++itOther) {
+            float childD = max(d, (*itMe)->distance(**itOther, myPosition,
+                                                    otherPosition));
+            childPairs.push_back(
+                ChildPair(childD, make_pair(itMe->get(), itOther->get())));
+        }
+    }
+    sort(childPairs.begin(), childPairs.end(),
+         [](const ChildPair &x, const ChildPair &y) { return x.first < y.first; });
+    for (auto it = childPairs.begin(); it != childPairs.end(); ++it) {
+        // Two leaves and all pairs above them overlap, nothing can be closer.
+        if (best <= 0.0f || it->first >= best)
+            return;
+        it->second.first->findSeparation(*it->second.second, myPosition,
+                                         otherPosition, it->first, best,
+                                         myClosest, otherClosest);
+    }
+}
 
+bool OctreeNode::checkCollision(const OctreeNode &n,
+                                const Eigen::Matrix4f &myPosition,
+                                const Eigen::Matrix4f &otherPosition,
+                                bool exact, ContactBuffer &contacts) const {
     // Recursively check for colliding spheres
-    if (eucDistance(myMidpoint, otherMidpoint) <=
-        (sphereRadius + n->getRadius())) {
-        if (children->size() == 0 && n->getChildren()->size() == 0) {
-            this->collides();
-            n->collides();
+    if (overlaps(n, myPosition, otherPosition)) {
+        if (children->size() == 0 && n.children->size() == 0) {
+            if (exact && !facesIntersect(n, myPosition, otherPosition))
+                return false;
+            Contact contact = {id, n.id};
+            contacts.push_back(contact);
             return true;
         } else {
             bool childCollision = false;
             for (auto itMe = children->begin(); itMe != children->end(); ++itMe) {
-                for (auto itOther = n->getChildren()->begin();
-                     itOther != n->getChildren()->end(); ++itOther)
+                for (auto itOther = n.children->begin();
+                     itOther != n.children->end(); ++itOther)
                     childCollision |=
-                    (*itMe)->checkCollision(*itOther, myPosition, otherPosition);
+                    (*itMe)->checkCollision(**itOther, myPosition, otherPosition,
+                                           exact, contacts);
             }
             return childCollision;
         }
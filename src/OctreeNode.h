@@ -13,22 +13,32 @@
 #include <Eigen/Dense>
 
 #include "BoundingBox.h"
-#include "MatrixStack.h"
-#include "Program.h"
-#include "Shape.h"
+#include "ThreadPool.h"
 #include <memory>
 #include <vector>
 
+// A pair of colliding leaves, given by their node ids.
+struct Contact {
+  size_t myNode;
+  size_t otherNode;
+};
+
+// Contacts found by a collision check. The buffer is owned by the caller, so
+// it can be reused and the octrees are not changed by a check.
+typedef std::vector<Contact> ContactBuffer;
+
 // A Octree-Node has a bounding-box, 0 to 8 child-nodes, faces which are located
 // in the bounding-box and in the sphere, the sphere-origin and the
 // sphere-radius.
 class OctreeNode : public std::enable_shared_from_this<OctreeNode> {
   std::shared_ptr<BoundingBox> bb;
   std::shared_ptr<std::vector<std::shared_ptr<OctreeNode>>> children;
+  OctreeNode *parent = nullptr;
   std::shared_ptr<std::vector<std::shared_ptr<Face>>> faces;
   std::shared_ptr<Eigen::Vector3f> sphereOrigin;
   float sphereRadius = 0.0f;
-  bool isColliding = false;
+  size_t deepness;
+  size_t id = 0;
 
   // Returns true, if all faces are in the sphere, false otherwise.
   bool allIn() const;
@@ -37,55 +47,111 @@ class OctreeNode : public std::enable_shared_from_this<OctreeNode> {
   float eucDistance(std::shared_ptr<Eigen::Vector3f> x,
                     std::shared_ptr<Eigen::Vector3f> y) const;
 
+  // Branch and bound step of separation(). 'd' is the largest sphere distance
+  // on the way from the roots to this node pair, 'best' the smallest bound
+  // found so far.
+  void findSeparation(const OctreeNode &otherNode,
+                      const Eigen::Matrix4f &myPosition,
+                      const Eigen::Matrix4f &otherPosition, float d,
+                      float &best, const OctreeNode **myClosest,
+                      const OctreeNode **otherClosest) const;
+
 public:
   // Creates the bounding-sphere of this node and adds child nodes if the
   // deepness is greater than 1.
+  // @arg pool: If not null, the upper levels of child nodes are created in
+  //            parallel on this pool
   OctreeNode(std::shared_ptr<BoundingBox> boundingBox,
              std::shared_ptr<std::vector<std::shared_ptr<Face>>> faces,
-             size_t deepness);
+             size_t deepness, std::shared_ptr<ThreadPool> pool = nullptr);
 
   inline std::shared_ptr<Eigen::Vector3f> getOrigin() const {
     return sphereOrigin;
   }
   inline float getRadius() const { return sphereRadius; }
   inline float getScale() const { return sphereRadius * 2; }
-  inline void collides() { isColliding = true; }
   inline std::shared_ptr<std::vector<std::shared_ptr<OctreeNode>>>
   getChildren() const {
     return children;
   }
+  inline OctreeNode *getParent() const { return parent; }
+  // Returns the number of levels of the subtree starting at this node.
+  inline size_t getDeepness() const { return deepness; }
+  inline bool isLeaf() const { return children->empty(); }
+  // Returns the id of the node, set by index().
+  inline size_t getId() const { return id; }
+
+  // Numbers this node and all child nodes in depth-first order and appends
+  // them to 'nodes', so the id of a node is its index in 'nodes'.
+  void index(std::vector<const OctreeNode *> &nodes);
 
-  // Sets 'isColliding' of node all child nodes to false.
-  void resetColliding();
+  // Appends this node and all child nodes in the order of index(), without
+  // changing their ids. For a tree numbered by index(), the id of a node is
+  // its index in 'nodes' again.
+  void collect(std::vector<const OctreeNode *> &nodes) const;
 
   // Returns number of child nodes.
   size_t getNumChildren() const;
 
-  // Draw all colliding spheres of this node and all child nodes
-  // @arg program: Program to draw the colliding sphers
-  // @arg shapeSphere: Sphere shape
-  // @arg MV: Matrix stack with the transitions of the object
-  void drawColliding(std::shared_ptr<Program> program,
-                     std::shared_ptr<Shape> shapeSphere,
-                     std::shared_ptr<MatrixStack> MV);
-
-  // Draw all spheres on the given tree-level
-  // @arg program: Program to draw the colliding sphers
-  // @arg level: level of the tree to draw (starts with 1)
-  // @arg shapeSphere: Sphere shape
-  // @arg MV: Matrix stack with the transitions of the object
-  void drawLevel(std::shared_ptr<Program> program,
-                 std::shared_ptr<Shape> shapeSphere, size_t level,
-                 std::shared_ptr<MatrixStack> MV);
+  // Returns true, if the sphere of this node overlaps the sphere of the other
+  // node.
+  // @arg otherNode: Node to check for an overlap
+  // @arg myPosition: Transition matrix of this node
+  // @arg otherPosition: Transition matrix of the other node
+  bool overlaps(const OctreeNode &otherNode,
+                const Eigen::Matrix4f &myPosition,
+                const Eigen::Matrix4f &otherPosition) const;
+
+  // Returns the distance between the sphere of this node and the sphere of the
+  // other node. The distance is negative, if the spheres overlap.
+  // @arg otherNode: Node to get the distance to
+  // @arg myPosition: Transition matrix of this node
+  // @arg otherPosition: Transition matrix of the other node
+  float distance(const OctreeNode &otherNode,
+                 const Eigen::Matrix4f &myPosition,
+                 const Eigen::Matrix4f &otherPosition) const;
+
+  // Returns true, if one of the faces of this node intersects one of the
+  // faces of the other node.
+  // @arg otherNode: Node to check for intersecting faces
+  // @arg myPosition: Transition matrix of this node
+  // @arg otherPosition: Transition matrix of the other node
+  bool facesIntersect(const OctreeNode &otherNode,
+                      const Eigen::Matrix4f &myPosition,
+                      const Eigen::Matrix4f &otherPosition) const;
+
+  // Returns how far the leaf spheres of this node and the other node are from
+  // a collision. Like checkCollision(), both trees are descended at the same
+  // time, and only pairs of two leaves can collide. The bound of a leaf pair
+  // is the largest sphere distance of it and of all node pairs above it, and
+  // the result is the smallest bound of all leaf pairs. Node pairs whose
+  // spheres are further apart than the best bound found so far are skipped.
+  // Returns 0 exactly if checkCollision() without the triangle test finds a
+  // collision. Since the objects move each sphere by at most the movement,
+  // they do not collide before they moved by the result.
+  // @arg otherNode: Node to get the separation to
+  // @arg myPosition: Transition matrix of this node
+  // @arg otherPosition: Transition matrix of the other node
+  // @arg myClosest: If not null, set to the closest leaf of this node
+  // @arg otherClosest: If not null, set to the closest leaf of the other node
+  float separation(const OctreeNode &otherNode,
+                   const Eigen::Matrix4f &myPosition,
+                   const Eigen::Matrix4f &otherPosition,
+                   const OctreeNode **myClosest = nullptr,
+                   const OctreeNode **otherClosest = nullptr) const;
 
   // Returnes true, if a leaf of this node collides with a leaf of the other
   // node.
   // @arg otherNode: Node to check for a collision
   // @arg myPosition: Transition matrix of this node
   // @arg otherPosition: Transition matrix of the other node
-  bool checkCollision(std::shared_ptr<OctreeNode> otherNode,
-                      std::shared_ptr<Eigen::Matrix4f> myPosition,
-                      std::shared_ptr<Eigen::Matrix4f> otherPosition);
+  // @arg exact: If true, two overlapping leaves only collide if their faces
+  //             intersect
+  // @arg contacts: The colliding leaf pairs are appended to this buffer
+  bool checkCollision(const OctreeNode &otherNode,
+                      const Eigen::Matrix4f &myPosition,
+                      const Eigen::Matrix4f &otherPosition, bool exact,
+                      ContactBuffer &contacts) const;
 };
 
 #endif /* OctreeNode_h */
@@ -55,6 +55,10 @@ bool Program::init() {
   pid = glCreateProgram();
   glAttachShader(pid, VS);
   glAttachShader(pid, FS);
+  glBindAttribLocation(pid, POS, "aPos");
+  glBindAttribLocation(pid, NOR, "aNor");
+  glBindAttribLocation(pid, TEX, "aTex");
+  glBindAttribLocation(pid, INST, "aInst");
   glLinkProgram(pid);
   glGetProgramiv(pid, GL_LINK_STATUS, &rc);
   if (!rc) {
@@ -74,12 +78,12 @@ void Program::bind() { glUseProgram(pid); }
 
 void Program::unbind() { glUseProgram(0); }
 
-void Program::addAttribute(const string &name) {
-  attributes[name] = glGetAttribLocation(pid, name.c_str());
+GLint Program::addAttribute(const string &name) {
+  return attributes[name] = glGetAttribLocation(pid, name.c_str());
 }
 
-void Program::addUniform(const string &name) {
-  uniforms[name] = glGetUniformLocation(pid, name.c_str());
+GLint Program::addUniform(const string &name) {
+  return uniforms[name] = glGetUniformLocation(pid, name.c_str());
 }
 
 GLint Program::getAttribute(const string &name) const {
@@ -10,6 +10,11 @@
 
 class Program {
 public:
+  // Locations of the vertex attributes aPos, aNor, aTex and aInst. They are
+  // bound before linking, so they are the same in all programs, and a shape
+  // can set up its buffers once for every program.
+  enum Attribute { POS = 0, NOR = 1, TEX = 2, INST = 3 };
+
   Program();
   virtual ~Program();
 
@@ -21,8 +26,10 @@ public:
   virtual void bind();
   virtual void unbind();
 
-  void addAttribute(const std::string &name);
-  void addUniform(const std::string &name);
+  // Add a variable and return its handle, so it can be kept instead of
+  // looking it up by name for each draw call.
+  GLint addAttribute(const std::string &name);
+  GLint addUniform(const std::string &name);
   GLint getAttribute(const std::string &name) const;
   GLint getUniform(const std::string &name) const;
 
@@ -1,5 +1,4 @@
 #include "Shape.h"
-#include <iostream>
 
 #define EIGEN_DONT_ALIGN_STATICALLY
 #include <Eigen/Dense>
@@ -7,58 +6,14 @@
 #include "GLSL.h"
 #include "Program.h"
 
-#define TINYOBJLOADER_IMPLEMENTATION
-#include "tiny_obj_loader.h"
-
 using namespace std;
 
-Shape::Shape() : eleBufID(0), posBufID(0), norBufID(0), texBufID(0) {}
-
-Shape::~Shape() {}
-
-void Shape::loadMesh(const string &meshName) {
-  // Load geometry
-  // Some obj files contain material information.
-  // We'll ignore them for this assignment.
-  vector<tinyobj::shape_t> shapes;
-  vector<tinyobj::material_t> objMaterials;
-  string errStr;
-  bool rc = tinyobj::LoadObj(shapes, objMaterials, errStr, meshName.c_str());
-  if (!rc) {
-    cerr << errStr << endl;
-  } else {
-    posBuf = shapes[0].mesh.positions;
-    norBuf = shapes[0].mesh.normals;
-    texBuf = shapes[0].mesh.texcoords;
-    eleBuf = shapes[0].mesh.indices;
-  }
-}
+Shape::Shape()
+    : eleBufID(0), posBufID(0), norBufID(0), texBufID(0), vaoID(0) {}
 
-void Shape::fitToUnitBox() {
-  // Scale the vertex positions so that they fit within [-1, +1] in all three
-  // dimensions.
-  Eigen::Vector3f vmin(posBuf[0], posBuf[1], posBuf[2]);
-  Eigen::Vector3f vmax(posBuf[0], posBuf[1], posBuf[2]);
-  for (int i = 0; i < (int)posBuf.size(); i += 3) {
-    Eigen::Vector3f v(posBuf[i], posBuf[i + 1], posBuf[i + 2]);
-    vmin(0) = min(vmin(0), v(0));
-    vmin(1) = min(vmin(1), v(1));
-    vmin(2) = min(vmin(2), v(2));
-    vmax(0) = max(vmax(0), v(0));
-    vmax(1) = max(vmax(1), v(1));
-    vmax(2) = max(vmax(2), v(2));
-  }
-  Eigen::Vector3f center = 0.5f * (vmin + vmax);
-  Eigen::Vector3f diff = vmax - vmin;
-  float diffmax = diff(0);
-  diffmax = max(diffmax, diff(1));
-  diffmax = max(diffmax, diff(2));
-  float scale = 1.0f / diffmax;
-  for (int i = 0; i < (int)posBuf.size(); i += 3) {
-    posBuf[i] = (posBuf[i] - center(0)) * scale;
-    posBuf[i + 1] = (posBuf[i + 1] - center(1)) * scale;
-    posBuf[i + 2] = (posBuf[i + 2] - center(2)) * scale;
-  }
+Shape::~Shape() {
+  if (vaoID != 0)
+    glDeleteVertexArrays(1, &vaoID);
 }
 
 void Shape::init() {
@@ -94,71 +49,92 @@ void Shape::init() {
   glBindBuffer(GL_ARRAY_BUFFER, 0);
   glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
 
+  // Record the buffers in a vertex array object
+  if (GLEW_VERSION_3_0 || GLEW_ARB_vertex_array_object) {
+    glGenVertexArrays(1, &vaoID);
+    glBindVertexArray(vaoID);
+    bindBuffers();
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+  }
+
   GLSL::checkError(GET_FILE_LINE);
 }
 
-void Shape::draw(const shared_ptr<Program> prog) const {
+void Shape::draw() const {
+  if (vaoID != 0)
+    glBindVertexArray(vaoID);
+  else
+    bindBuffers();
+
+  // Draw
+  glDrawElements(GL_TRIANGLES, (int)eleBuf.size(), GL_UNSIGNED_INT,
+                 (const void *)0);
+
+  if (vaoID != 0)
+    glBindVertexArray(0);
+  else
+    unbindBuffers();
+}
+
+void Shape::drawInstanced(unsigned instBufID, int count) const {
+  if (vaoID != 0)
+    glBindVertexArray(vaoID);
+  else
+    bindBuffers();
+
+  // Bind instance buffer, one entry per instance instead of per vertex
+  glEnableVertexAttribArray(Program::INST);
+  glBindBuffer(GL_ARRAY_BUFFER, instBufID);
+  glVertexAttribPointer(Program::INST, 4, GL_FLOAT, GL_FALSE, 0,
+                        (const void *)0);
+  glVertexAttribDivisor(Program::INST, 1);
+
+  // Draw
+  glDrawElementsInstanced(GL_TRIANGLES, (int)eleBuf.size(), GL_UNSIGNED_INT,
+                          (const void *)0, count);
+
+  glVertexAttribDivisor(Program::INST, 0);
+  glDisableVertexAttribArray(Program::INST);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  if (vaoID != 0)
+    glBindVertexArray(0);
+  else
+    unbindBuffers();
+}
+
+void Shape::bindBuffers() const {
   // Bind position buffer
-  int h_pos = prog->getAttribute("aPos");
-  glEnableVertexAttribArray(h_pos);
+  glEnableVertexAttribArray(Program::POS);
   glBindBuffer(GL_ARRAY_BUFFER, posBufID);
-  glVertexAttribPointer(h_pos, 3, GL_FLOAT, GL_FALSE, 0, (const void *)0);
+  glVertexAttribPointer(Program::POS, 3, GL_FLOAT, GL_FALSE, 0,
+                        (const void *)0);
 
   // Bind normal buffer
-  int h_nor = prog->getAttribute("aNor");
-  if (h_nor != -1 && norBufID != 0) {
-    glEnableVertexAttribArray(h_nor);
+  if (norBufID != 0) {
+    glEnableVertexAttribArray(Program::NOR);
     glBindBuffer(GL_ARRAY_BUFFER, norBufID);
-    glVertexAttribPointer(h_nor, 3, GL_FLOAT, GL_FALSE, 0, (const void *)0);
+    glVertexAttribPointer(Program::NOR, 3, GL_FLOAT, GL_FALSE, 0,
+                          (const void *)0);
   }
 
   // Bind texcoords buffer
-  int h_tex = prog->getAttribute("aTex");
-  if (h_tex != -1 && texBufID != 0) {
-    glEnableVertexAttribArray(h_tex);
+  if (texBufID != 0) {
+    glEnableVertexAttribArray(Program::TEX);
     glBindBuffer(GL_ARRAY_BUFFER, texBufID);
-    glVertexAttribPointer(h_tex, 2, GL_FLOAT, GL_FALSE, 0, (const void *)0);
+    glVertexAttribPointer(Program::TEX, 2, GL_FLOAT, GL_FALSE, 0,
+                          (const void *)0);
   }
 
   // Bind element buffer
   glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, eleBufID);
+}
 
-  // Draw
-  glDrawElements(GL_TRIANGLES, (int)eleBuf.size(), GL_UNSIGNED_INT,
-                 (const void *)0);
-
+void Shape::unbindBuffers() const {
   // Disable and unbind
-  if (h_tex != -1) {
-    glDisableVertexAttribArray(h_tex);
-  }
-  if (h_nor != -1) {
-    glDisableVertexAttribArray(h_nor);
-  }
-  glDisableVertexAttribArray(h_pos);
+  glDisableVertexAttribArray(Program::TEX);
+  glDisableVertexAttribArray(Program::NOR);
+  glDisableVertexAttribArray(Program::POS);
   glBindBuffer(GL_ARRAY_BUFFER, 0);
   glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
-
-  GLSL::checkError(GET_FILE_LINE);
-}
-
-shared_ptr<vector<shared_ptr<Eigen::Vector3f>>> Shape::getPositions() const {
-  shared_ptr<vector<shared_ptr<Eigen::Vector3f>>> positions =
-      make_shared<vector<shared_ptr<Eigen::Vector3f>>>();
-  for (size_t i = 0; i < posBuf.size(); i += 3) {
-    positions->push_back(make_shared<Eigen::Vector3f>(
-        posBuf.at(i), posBuf.at(i + 1), posBuf.at(i + 2)));
-  }
-  return positions;
-}
-
-shared_ptr<vector<shared_ptr<Face>>> Shape::getFaces() const {
-  shared_ptr<vector<shared_ptr<Eigen::Vector3f>>> positions = getPositions();
-  shared_ptr<vector<shared_ptr<Face>>> faces =
-      make_shared<vector<shared_ptr<Face>>>();
-  for (size_t i = 0; i < eleBuf.size(); i += 3) {
-    faces->push_back(make_shared<Face>(positions->at(eleBuf[i]),
-                                       positions->at(eleBuf[i + 1]),
-                                       positions->at(eleBuf[i + 2])));
-  }
-  return faces;
 }
@@ -2,44 +2,34 @@
 #ifndef _SHAPE_H_
 #define _SHAPE_H_
 
-#include <memory>
-#include <string>
-#include <vector>
+#include "Mesh.h"
 
-#define EIGEN_DONT_ALIGN_STATICALLY
-#include <Eigen/Dense>
-
-class Program;
-
-struct Face {
-  std::shared_ptr<Eigen::Vector3f> a, b, c;
-
-  Face(std::shared_ptr<Eigen::Vector3f> _a, std::shared_ptr<Eigen::Vector3f> _b,
-       std::shared_ptr<Eigen::Vector3f> _c)
-      : a(_a), b(_b), c(_c) {}
-};
-
-class Shape {
+// A mesh which can be drawn. init() sends the buffers to the GPU and records
+// them in a vertex array object, so a draw call only binds that object.
+class Shape : public Mesh {
 public:
   Shape();
   virtual ~Shape();
-  void loadMesh(const std::string &meshName);
-  void fitToUnitBox();
   void init();
-  void draw(const std::shared_ptr<Program> prog) const;
-  std::shared_ptr<std::vector<std::shared_ptr<Eigen::Vector3f>>>
-  getPositions() const;
-  std::shared_ptr<std::vector<std::shared_ptr<Face>>> getFaces() const;
+  // Draws the shape with the bound program. The program must take the
+  // attributes at the locations of Program.
+  void draw() const;
+  // Draws 'count' instances of the shape with one draw call. The buffer holds
+  // 4 floats per instance for the attribute "aInst" of the bound program.
+  void drawInstanced(unsigned instBufID, int count) const;
 
 private:
-  std::vector<unsigned int> eleBuf;
-  std::vector<float> posBuf;
-  std::vector<float> norBuf;
-  std::vector<float> texBuf;
+  // Binds the buffers to the attribute locations of Program. Without vertex
+  // array objects, this is done for each draw call.
+  void bindBuffers() const;
+  void unbindBuffers() const;
+
   unsigned eleBufID;
   unsigned posBufID;
   unsigned norBufID;
   unsigned texBufID;
+  // 0, if the OpenGL version has no vertex array objects.
+  unsigned vaoID;
 };
 
 #endif
@@ -0,0 +1,95 @@
+//
+//  Simulation.cpp
+//  SphereOctree
+//
+
+#include "Simulation.h"
+
+using namespace std;
+
+Simulation::Simulation(shared_ptr<World> w, int maxStepsPerFrame)
+    : world(w), maxSteps(maxStepsPerFrame) {
+  takeSnapshot(snapshots[front]);
+  thread = std::thread(&Simulation::work, this);
+}
+
+Simulation::~Simulation() {
+  {
+    lock_guard<std::mutex> lock(mutex);
+    stop = true;
+  }
+  wakeUp.notify_all();
+  thread.join();
+}
+
+void Simulation::start(double t) {
+  {
+    lock_guard<std::mutex> lock(mutex);
+    time = t;
+    busy = true;
+  }
+  wakeUp.notify_all();
+}
+
+void Simulation::wait() {
+  unique_lock<std::mutex> lock(mutex);
+  done.wait(lock, [this]() { return !busy; });
+  if (finished) {
+    front = 1 - front;
+    finished = false;
+  }
+}
+
+void Simulation::restart() {
+  accumulator = 0.0;
+  collision = false;
+  takeSnapshot(snapshots[front]);
+}
+
+void Simulation::work() {
+  while (true) {
+    double t;
+    {
+      unique_lock<std::mutex> lock(mutex);
+      wakeUp.wait(lock, [this]() { return busy || stop; });
+      if (stop)
+        return;
+      t = time;
+    }
+    advance(t);
+    {
+      lock_guard<std::mutex> lock(mutex);
+      busy = false;
+      finished = true;
+    }
+    done.notify_all();
+  }
+}
+
+void Simulation::advance(double t) {
+  accumulator += t;
+  int steps = 0;
+  while (accumulator >= world->getTimeStep() && !collision) {
+    collision = world->step();
+    accumulator -= world->getTimeStep();
+    if (++steps == maxSteps)
+      accumulator = 0.0;
+  }
+  takeSnapshot(snapshots[1 - front]);
+}
+
+void Simulation::takeSnapshot(Snapshot &snapshot) const {
+  // The objects are drawn at the time which was not simulated yet, between
+  // their last two steps.
+  float alpha =
+      collision ? 1.0f : (float)(accumulator / world->getTimeStep());
+  const vector<shared_ptr<WorldObject>> &objs = world->getObjects();
+  snapshot.objects.resize(objs.size());
+  for (size_t i = 0; i < objs.size(); ++i) {
+    auto m = make_shared<MatrixStack>();
+    objs[i]->addTransitionMatrix(m, alpha);
+    snapshot.objects[i].transform = m->topMatrix();
+    snapshot.objects[i].collidingNodes = objs[i]->getCollidingNodes();
+  }
+  snapshot.collision = collision;
+}
@@ -0,0 +1,98 @@
+//
+//  Simulation.h
+//  SphereOctree
+//
+
+#ifndef Simulation_h
+#define Simulation_h
+
+#define EIGEN_DONT_ALIGN_STATICALLY
+#include <Eigen/Dense>
+
+#include "World.h"
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// State of an object for drawing, copied from the world after the steps of a
+// frame.
+struct ObjectSnapshot {
+  // Translation and rotation, between the last two steps at the time which
+  // was not simulated yet.
+  Eigen::Matrix4f transform;
+  // Ids of the colliding leaves.
+  std::vector<size_t> collidingNodes;
+};
+
+// State of all objects after the steps of a frame.
+struct Snapshot {
+  std::vector<ObjectSnapshot> objects;
+  // True, if every object is colliding.
+  bool collision = false;
+};
+
+// Runs the steps of a world on its own thread, so a viewer can draw the last
+// frame while the steps of the next frame are simulated. The steps have a
+// fixed time step; each call of start() runs as many of them as fit into the
+// given time. The result is written to one of two snapshots, which is drawn
+// after the next wait(), while the steps write the other one.
+class Simulation {
+  std::shared_ptr<World> world;
+  int maxSteps;
+  // Time which was not simulated yet.
+  double accumulator = 0.0;
+  bool collision = false;
+  // The snapshot 'front' is drawn, the other one is written by the steps.
+  Snapshot snapshots[2];
+  size_t front = 0;
+
+  std::thread thread;
+  std::mutex mutex;
+  std::condition_variable wakeUp;
+  std::condition_variable done;
+  // Time to simulate by the next steps.
+  double time = 0.0;
+  bool busy = false;
+  bool finished = false;
+  bool stop = false;
+
+  // Main loop of the simulation thread.
+  void work();
+
+  // Runs the steps for the given time and writes the back snapshot.
+  void advance(double time);
+
+  // Copies the state of the world into a snapshot.
+  void takeSnapshot(Snapshot &snapshot) const;
+
+public:
+  // @arg world: World to simulate
+  // @arg maxStepsPerFrame: Steps per start() at most. If the simulation is
+  //                        slower, it falls behind the real time instead of
+  //                        taking longer and longer for each frame.
+  Simulation(std::shared_ptr<World> world, int maxStepsPerFrame);
+  virtual ~Simulation();
+
+  // Starts the steps for the given time on the simulation thread and returns.
+  // The world must not be used until wait() returns.
+  // @arg time: Seconds since the last start()
+  void start(double time);
+
+  // Waits until the steps started last are done and shows their snapshot.
+  // Afterwards, the world can be changed until the next start().
+  void wait();
+
+  // Drops the time which was not simulated yet and takes a snapshot of the
+  // world, e.g. after it was reset. Must not be called between start() and
+  // wait().
+  void restart();
+
+  // Returns the snapshot of the last finished steps. It is not changed until
+  // the next wait().
+  inline const Snapshot &getSnapshot() const { return snapshots[front]; }
+  inline std::shared_ptr<World> getWorld() const { return world; }
+};
+
+#endif /* Simulation_h */
@@ -0,0 +1,100 @@
+//
+//  SpatialHashGrid.cpp
+//  SphereOctree
+//
+
+#include "SpatialHashGrid.h"
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+
+SpatialHashGrid::SpatialHashGrid(float size) : cellSize(size) {}
+
+void SpatialHashGrid::update(const vector<Eigen::AlignedBox3f> &bounds) {
+  boxes = bounds;
+  pairs.clear();
+  if (boxes.empty())
+    return;
+
+  float size = cellSize;
+  if (size <= 0.0f) {
+    Eigen::Vector3f average = Eigen::Vector3f::Zero();
+    for (auto it = boxes.begin(); it != boxes.end(); ++it)
+      average += it->sizes();
+    size = average.maxCoeff() / boxes.size();
+    if (size <= 0.0f)
+      size = 1.0f;
+  }
+
+  // Add each box to all cells it touches.
+  entries.clear();
+  oversized.clear();
+  for (uint32_t i = 0; i < boxes.size(); ++i) {
+    const Eigen::AlignedBox3f &box = boxes[i];
+    int minX = cell(box.min().x(), size), maxX = cell(box.max().x(), size);
+    int minY = cell(box.min().y(), size), maxY = cell(box.max().y(), size);
+    int minZ = cell(box.min().z(), size), maxZ = cell(box.max().z(), size);
+    int64_t cells = ((int64_t)maxX - minX + 1) * ((int64_t)maxY - minY + 1) *
+                    ((int64_t)maxZ - minZ + 1);
+    if (cells > MAX_CELLS) {
+      oversized.push_back(i);
+      continue;
+    }
+    for (int x = minX; x <= maxX; ++x) {
+      for (int y = minY; y <= maxY; ++y) {
+        for (int z = minZ; z <= maxZ; ++z) {
+          Entry entry = {x, y, z, i};
+          entries.push_back(entry);
+        }
+      }
+    }
+  }
+
+  // Counting sort of the entries by bucket, with about two buckets per entry.
+  bucketStart.assign(2 * entries.size() + 2, 0);
+  for (auto it = entries.begin(); it != entries.end(); ++it)
+    ++bucketStart[bucket(it->x, it->y, it->z) + 1];
+  for (size_t i = 1; i < bucketStart.size(); ++i)
+    bucketStart[i] += bucketStart[i - 1];
+  buckets.resize(entries.size());
+  vector<uint32_t> fill(bucketStart.begin(), bucketStart.end() - 1);
+  for (auto it = entries.begin(); it != entries.end(); ++it)
+    buckets[fill[bucket(it->x, it->y, it->z)]++] = *it;
+
+  // Two boxes can share several cells. The pair is only added in the cell,
+  // which contains the minimum corner of the intersection of both boxes.
+  for (size_t b = 0; b + 1 < bucketStart.size(); ++b) {
+    for (uint32_t i = bucketStart[b]; i < bucketStart[b + 1]; ++i) {
+      const Entry &e = buckets[i];
+      for (uint32_t j = i + 1; j < bucketStart[b + 1]; ++j) {
+        const Entry &f = buckets[j];
+        if (e.x != f.x || e.y != f.y || e.z != f.z)
+          continue;
+        const Eigen::AlignedBox3f &boxE = boxes[e.object];
+        const Eigen::AlignedBox3f &boxF = boxes[f.object];
+        if (!boxE.intersects(boxF))
+          continue;
+        Eigen::Vector3f corner = boxE.min().cwiseMax(boxF.min());
+        if (cell(corner.x(), size) != e.x || cell(corner.y(), size) != e.y ||
+            cell(corner.z(), size) != e.z)
+          continue;
+        pairs.push_back(Pair(min(e.object, f.object), max(e.object, f.object)));
+      }
+    }
+  }
+
+  // The oversized boxes are tested against all boxes. A pair of two oversized
+  // boxes is only tested from the one with the larger index.
+  for (size_t k = 0; k < oversized.size(); ++k) {
+    uint32_t i = oversized[k];
+    for (uint32_t j = 0; j < boxes.size(); ++j) {
+      if (j == i || (j > i && binary_search(oversized.begin(),
+                                            oversized.end(), j)))
+        continue;
+      if (boxes[i].intersects(boxes[j]))
+        pairs.push_back(Pair(min(i, j), max(i, j)));
+    }
+  }
+  sort(pairs.begin(), pairs.end());
+}
@@ -0,0 +1,71 @@
+//
+//  SpatialHashGrid.h
+//  SphereOctree
+//
+
+#ifndef SpatialHashGrid_h
+#define SpatialHashGrid_h
+
+#include "Broadphase.h"
+#include <cmath>
+#include <cstdint>
+
+// A uniform grid, whose cells are hashed into a table, so only the occupied
+// cells need memory. Each box is added to all cells it touches, and only boxes
+// in the same cell are tested against each other. The grid is rebuilt at each
+// update with a counting sort by bucket, so this is linear in the number of
+// objects, as long as the objects have a similar size. A box which would cover
+// more than MAX_CELLS cells is not added to the grid, but tested against all
+// other boxes instead.
+class SpatialHashGrid : public Broadphase {
+  struct Entry {
+    int x;
+    int y;
+    int z;
+    uint32_t object;
+  };
+
+  float cellSize;
+  std::vector<Eigen::AlignedBox3f> boxes;
+  std::vector<Entry> entries;
+  // Entries sorted by bucket, the entries of bucket i are in
+  // [bucketStart[i], bucketStart[i + 1]).
+  std::vector<Entry> buckets;
+  std::vector<uint32_t> bucketStart;
+  // Boxes which are not in the grid, because they cover too many cells.
+  std::vector<uint32_t> oversized;
+  std::vector<Pair> pairs;
+
+  // Returns the bucket of a cell.
+  inline size_t bucket(int x, int y, int z) const {
+    uint32_t h = (uint32_t)x * 73856093u ^ (uint32_t)y * 19349663u ^
+                 (uint32_t)z * 83492791u;
+    return h % (bucketStart.size() - 1);
+  }
+
+  // Returns the cell coordinate of a position along one axis. Positions far
+  // away from the origin are clamped to the outermost cells, so the
+  // coordinate always fits into an int.
+  inline int cell(float value, float size) const {
+    const float limit = 1 << 30;
+    float c = std::floor(value / size);
+    if (!(c > -limit))
+      return -(1 << 30);
+    if (c > limit)
+      return 1 << 30;
+    return (int)c;
+  }
+
+public:
+  // Largest number of cells a box is added to.
+  static const int64_t MAX_CELLS = 64;
+
+  // @arg cellSize: Edge length of a cell. If 0, the largest edge of the average
+  //                box is used at each update.
+  explicit SpatialHashGrid(float cellSize = 0.0f);
+
+  void update(const std::vector<Eigen::AlignedBox3f> &bounds);
+  inline const std::vector<Pair> &getPairs() const { return pairs; }
+};
+
+#endif /* SpatialHashGrid_h */
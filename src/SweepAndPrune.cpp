@@ -0,0 +1,81 @@
+//
+//  SweepAndPrune.cpp
+//  SphereOctree
+//
+
+#include "SweepAndPrune.h"
+#include <algorithm>
+
+using namespace std;
+
+void SweepAndPrune::update(const vector<Eigen::AlignedBox3f> &bounds) {
+  bool sameObjects = bounds.size() == boxes.size();
+  boxes = bounds;
+  if (!sameObjects) {
+    rebuild();
+  } else {
+    for (int axis = 0; axis < 3; ++axis) {
+      for (auto it = axes[axis].begin(); it != axes[axis].end(); ++it) {
+        const Eigen::AlignedBox3f &box = boxes[it->object];
+        it->value = it->isMin ? box.min()(axis) : box.max()(axis);
+      }
+      sortAxis(axis);
+    }
+  }
+
+  pairs.clear();
+  for (auto it = overlaps.begin(); it != overlaps.end(); ++it)
+    pairs.push_back(Pair(*it >> 32, *it & 0xffffffff));
+  sort(pairs.begin(), pairs.end());
+}
+
+void SweepAndPrune::rebuild() {
+  overlaps.clear();
+  for (int axis = 0; axis < 3; ++axis) {
+    axes[axis].clear();
+    for (uint32_t i = 0; i < boxes.size(); ++i) {
+      Endpoint min = {boxes[i].min()(axis), i, true};
+      Endpoint max = {boxes[i].max()(axis), i, false};
+      axes[axis].push_back(min);
+      axes[axis].push_back(max);
+    }
+    sort(axes[axis].begin(), axes[axis].end(), before);
+  }
+
+  // Objects whose start point was passed, but not their end point, overlap
+  // the next object on the first axis.
+  vector<uint32_t> active;
+  for (auto it = axes[0].begin(); it != axes[0].end(); ++it) {
+    if (it->isMin) {
+      for (auto other = active.begin(); other != active.end(); ++other) {
+        if (boxes[it->object].intersects(boxes[*other]))
+          overlaps.insert(key(it->object, *other));
+      }
+      active.push_back(it->object);
+    } else {
+      active.erase(find(active.begin(), active.end(), it->object));
+    }
+  }
+}
+
+void SweepAndPrune::sortAxis(int axis) {
+  vector<Endpoint> &points = axes[axis];
+  for (size_t i = 1; i < points.size(); ++i) {
+    Endpoint point = points[i];
+    size_t j = i;
+    while (j > 0 && before(point, points[j - 1])) {
+      const Endpoint &other = points[j - 1];
+      // A start point moving before an end point can start an overlap, an end
+      // point moving before a start point ends one.
+      if (point.isMin && !other.isMin) {
+        if (boxes[point.object].intersects(boxes[other.object]))
+          overlaps.insert(key(point.object, other.object));
+      } else if (!point.isMin && other.isMin) {
+        overlaps.erase(key(point.object, other.object));
+      }
+      points[j] = other;
+      --j;
+    }
+    points[j] = point;
+  }
+}
@@ -0,0 +1,54 @@
+//
+//  SweepAndPrune.h
+//  SphereOctree
+//
+
+#ifndef SweepAndPrune_h
+#define SweepAndPrune_h
+
+#include "Broadphase.h"
+#include <cstdint>
+#include <unordered_set>
+
+// Sweep and prune keeps the start and end points of the boxes sorted along
+// each axis. Objects only move a little per step, so the lists are almost
+// sorted and an insertion sort updates them in nearly linear time. Every swap
+// of a start point with an end point changes whether two boxes overlap on that
+// axis, so the overlapping pairs are updated by the swaps too.
+class SweepAndPrune : public Broadphase {
+  struct Endpoint {
+    float value;
+    uint32_t object;
+    bool isMin;
+  };
+
+  std::vector<Eigen::AlignedBox3f> boxes;
+  std::vector<Endpoint> axes[3];
+  // Overlapping pairs, the smaller index in the upper 32 bits.
+  std::unordered_set<uint64_t> overlaps;
+  std::vector<Pair> pairs;
+
+  // Inserts all objects and finds the overlapping pairs by sweeping along the
+  // first axis.
+  void rebuild();
+
+  // Sorts the end points along an axis and adds or removes the pairs, whose
+  // end points were swapped.
+  void sortAxis(int axis);
+
+  // Returns true, if end point a has to be before end point b. On equal
+  // values, start points are first, so touching boxes overlap.
+  static inline bool before(const Endpoint &a, const Endpoint &b) {
+    return a.value < b.value || (a.value == b.value && a.isMin && !b.isMin);
+  }
+
+  static inline uint64_t key(uint32_t a, uint32_t b) {
+    return a < b ? (uint64_t)a << 32 | b : (uint64_t)b << 32 | a;
+  }
+
+public:
+  void update(const std::vector<Eigen::AlignedBox3f> &bounds);
+  inline const std::vector<Pair> &getPairs() const { return pairs; }
+};
+
+#endif /* SweepAndPrune_h */
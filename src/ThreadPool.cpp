@@ -0,0 +1,139 @@
+//
+//  ThreadPool.cpp
+//  SphereOctree
+//
+
+#include "ThreadPool.h"
+#include <algorithm>
+
+using namespace std;
+
+namespace {
+
+// Pool and queue of the current thread, if it is a worker.
+thread_local const ThreadPool *currentPool = nullptr;
+thread_local size_t currentIndex = 0;
+
+} // namespace
+
+ThreadPool::ThreadPool(size_t numThreads) {
+  if (numThreads == 0)
+    numThreads = max(1u, thread::hardware_concurrency());
+  for (size_t i = 0; i < numThreads; ++i)
+    queues.push_back(unique_ptr<Queue>(new Queue()));
+  for (size_t i = 1; i < numThreads; ++i)
+    threads.push_back(thread(&ThreadPool::work, this, i));
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    lock_guard<std::mutex> lock(mutex);
+    stop = true;
+  }
+  wakeUp.notify_all();
+  for (auto it = threads.begin(); it != threads.end(); ++it)
+    it->join();
+}
+
+size_t ThreadPool::getIndex() const {
+  return currentPool == this ? currentIndex : 0;
+}
+
+void ThreadPool::run(vector<function<void()>> &tasks) {
+  if (tasks.empty())
+    return;
+  atomic<size_t> remaining(tasks.size());
+  // A worker keeps the tasks in its own queue, the others steal them. Tasks
+  // from outside of the pool are dealt to all queues.
+  size_t index = getIndex();
+  for (size_t i = 0; i < tasks.size(); ++i) {
+    Queue &queue = *queues[index != 0 ? index : i % queues.size()];
+    lock_guard<std::mutex> lock(queue.mutex);
+    Task task = {move(tasks[i]), &remaining};
+    queue.tasks.push_back(move(task));
+  }
+  {
+    lock_guard<std::mutex> lock(mutex);
+    ++generation;
+  }
+  wakeUp.notify_all();
+
+  // Work on any tasks until the own ones are done. If there is nothing left
+  // to take, the own tasks run on other threads.
+  Task task;
+  while (remaining > 0) {
+    if (pop(index, task)) {
+      execute(task);
+    } else {
+      unique_lock<std::mutex> lock(mutex);
+      done.wait(lock, [&remaining]() { return remaining == 0; });
+    }
+  }
+}
+
+void ThreadPool::parallelFor(size_t begin, size_t end,
+                             const function<void(size_t)> &body,
+                             size_t grain) {
+  if (begin >= end)
+    return;
+  size_t count = end - begin;
+  size_t size = max(grain, (count + 4 * getNumThreads() - 1) /
+                               (4 * getNumThreads()));
+  vector<function<void()>> tasks;
+  for (size_t first = begin; first < end; first += size) {
+    size_t last = min(end, first + size);
+    tasks.push_back([first, last, &body]() {
+      for (size_t i = first; i < last; ++i)
+        body(i);
+    });
+  }
+  run(tasks);
+}
+
+bool ThreadPool::pop(size_t index, Task &task) {
+  {
+    Queue &own = *queues[index];
+    lock_guard<std::mutex> lock(own.mutex);
+    if (!own.tasks.empty()) {
+      task = move(own.tasks.back());
+      own.tasks.pop_back();
+      return true;
+    }
+  }
+  for (size_t i = 1; i < queues.size(); ++i) {
+    Queue &other = *queues[(index + i) % queues.size()];
+    lock_guard<std::mutex> lock(other.mutex);
+    if (!other.tasks.empty()) {
+      task = move(other.tasks.front());
+      other.tasks.pop_front();
+      return true;
+    }
+  }
+  return false;
+}
+
+void ThreadPool::execute(Task &task) {
+  task.function();
+  if (--*task.remaining == 0) {
+    lock_guard<std::mutex> lock(mutex);
+    done.notify_all();
+  }
+}
+
+void ThreadPool::work(size_t index) {
+  currentPool = this;
+  currentIndex = index;
+  size_t seen = 0;
+  Task task;
+  while (true) {
+    {
+      unique_lock<std::mutex> lock(mutex);
+      wakeUp.wait(lock, [&]() { return stop || generation != seen; });
+      if (stop)
+        return;
+      seen = generation;
+    }
+    while (pop(index, task))
+      execute(task);
+  }
+}
@@ -0,0 +1,83 @@
+//
+//  ThreadPool.h
+//  SphereOctree
+//
+
+#ifndef ThreadPool_h
+#define ThreadPool_h
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// A pool of worker threads with one task queue per thread. A thread takes
+// tasks from the back of its own queue and, if it is empty, steals tasks from
+// the front of the other queues, so threads with cheap tasks help the ones
+// with expensive tasks.
+//
+// run() forks tasks and joins them. It can be called from a task as well: the
+// new tasks are put into the queue of the calling worker, which works on them
+// until they are done, instead of waiting. Thus nested parallel work, like the
+// octree of an object built on the pool while other objects are built, shares
+// the threads of one pool instead of starting more threads than cores.
+class ThreadPool {
+  struct Task {
+    std::function<void()> function;
+    // Tasks of the same run() call, which are not done yet.
+    std::atomic<size_t> *remaining;
+  };
+
+  struct Queue {
+    std::mutex mutex;
+    std::deque<Task> tasks;
+  };
+
+  // Queue 0 belongs to the threads outside of the pool, which call run(), the
+  // others to the workers.
+  std::vector<std::unique_ptr<Queue>> queues;
+  std::vector<std::thread> threads;
+  std::mutex mutex;
+  std::condition_variable wakeUp;
+  std::condition_variable done;
+  size_t generation = 0;
+  bool stop = false;
+
+  // Takes a task from the own queue or steals one from another queue. Returns
+  // false, if all queues are empty.
+  bool pop(size_t index, Task &task);
+
+  // Runs a task and wakes up the threads waiting in run(), if it was the last
+  // one of its call.
+  void execute(Task &task);
+
+  // Main loop of a worker thread.
+  void work(size_t index);
+
+  // Returns the queue of the calling thread.
+  size_t getIndex() const;
+
+public:
+  // Creates a pool, which runs tasks on 'numThreads' threads including the
+  // thread calling run(). 0 uses one thread per hardware thread.
+  explicit ThreadPool(size_t numThreads = 0);
+  virtual ~ThreadPool();
+
+  // Runs all tasks and returns when all are done. The calling thread works on
+  // the tasks as well.
+  void run(std::vector<std::function<void()>> &tasks);
+
+  // Calls 'body' for each index in [begin, end) on the pool. The indices are
+  // split into a few ranges per thread, but not smaller than 'grain'.
+  void parallelFor(size_t begin, size_t end,
+                   const std::function<void(size_t)> &body, size_t grain = 1);
+
+  // Returns the number of threads including the calling thread.
+  inline size_t getNumThreads() const { return queues.size(); }
+};
+
+#endif /* ThreadPool_h */
@@ -0,0 +1,169 @@
+//
+//  Trace.cpp
+//  SphereOctree
+//
+
+#include "Trace.h"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+using namespace std;
+
+// First bytes of a trace file and its version.
+static const char TRACE_MAGIC[4] = {'S', 'O', 'T', 'R'};
+static const uint32_t TRACE_VERSION = 2;
+
+namespace {
+
+// Returns the bits of a float.
+uint32_t floatBits(float f) {
+  uint32_t bits;
+  memcpy(&bits, &f, sizeof(bits));
+  return bits;
+}
+
+// Writes an integer with its lowest byte first, so the files are the same on
+// every platform.
+template <typename T> void writeInt(ofstream &out, T value) {
+  for (size_t i = 0; i < sizeof(T); ++i) {
+    char byte = (char)((value >> (8 * i)) & 0xff);
+    out.write(&byte, 1);
+  }
+}
+
+// Reads an integer written by writeInt().
+template <typename T> void readInt(ifstream &in, T &value) {
+  value = 0;
+  for (size_t i = 0; i < sizeof(T); ++i) {
+    char byte = 0;
+    in.read(&byte, 1);
+    value |= (T)(unsigned char)byte << (8 * i);
+  }
+}
+
+} // namespace
+
+Trace::Trace(const World &world)
+    : seed(world.getSeed()), timeStep(world.getTimeStep()),
+      exact(world.getExact()), numObjects(world.getObjects().size()) {}
+
+Trace::ObjectState Trace::getState(const WorldObject &obj) {
+  ObjectState state;
+  Eigen::Vector3f position = obj.getPosition();
+  for (int i = 0; i < 3; ++i)
+    state.position[i] = floatBits(position(i));
+  Eigen::Quaternionf orientation = obj.getOrientation();
+  state.orientation[0] = floatBits(orientation.w());
+  state.orientation[1] = floatBits(orientation.x());
+  state.orientation[2] = floatBits(orientation.y());
+  state.orientation[3] = floatBits(orientation.z());
+  state.colliding = obj.getColliding();
+
+  // FNV-1a hash of the leaf ids. The order of the colliding leaves depends on
+  // the order of the pairs, so they are sorted first.
+  vector<size_t> ids = obj.getCollidingNodes();
+  sort(ids.begin(), ids.end());
+  state.contacts = 14695981039346656037ULL;
+  for (auto it = ids.begin(); it != ids.end(); ++it) {
+    state.contacts ^= (uint64_t)*it;
+    state.contacts *= 1099511628211ULL;
+  }
+  return state;
+}
+
+void Trace::record(const World &world) {
+  const vector<shared_ptr<WorldObject>> &objs = world.getObjects();
+  for (auto it = objs.begin(); it != objs.end(); ++it)
+    states.push_back(getState(**it));
+}
+
+int Trace::compare(size_t step, const World &world) const {
+  const vector<shared_ptr<WorldObject>> &objs = world.getObjects();
+  for (size_t i = 0; i < numObjects; ++i) {
+    if (i >= objs.size())
+      return (int)i;
+    const ObjectState &recorded = states.at(step * numObjects + i);
+    ObjectState state = getState(*objs[i]);
+    if (memcmp(recorded.position, state.position, sizeof(state.position)) !=
+            0 ||
+        memcmp(recorded.orientation, state.orientation,
+               sizeof(state.orientation)) != 0 ||
+        recorded.colliding != state.colliding ||
+        recorded.contacts != state.contacts)
+      return (int)i;
+  }
+  return -1;
+}
+
+void Trace::apply(World &world) const {
+  world.setTimeStep(timeStep);
+  world.setExact(exact);
+  world.setSeed(seed);
+}
+
+bool Trace::save(const string &fileName) const {
+  ofstream out(fileName.c_str(), ios::binary);
+  if (!out) {
+    cerr << "Can not write trace " << fileName << endl;
+    return false;
+  }
+  out.write(TRACE_MAGIC, sizeof(TRACE_MAGIC));
+  writeInt(out, TRACE_VERSION);
+  writeInt(out, seed);
+  writeInt(out, floatBits(timeStep));
+  writeInt(out, (uint8_t)exact);
+  writeInt(out, numObjects);
+  writeInt(out, (uint64_t)getNumSteps());
+  for (auto it = states.begin(); it != states.end(); ++it) {
+    for (int i = 0; i < 3; ++i)
+      writeInt(out, it->position[i]);
+    for (int i = 0; i < 4; ++i)
+      writeInt(out, it->orientation[i]);
+    writeInt(out, it->colliding);
+    writeInt(out, it->contacts);
+  }
+  return (bool)out;
+}
+
+bool Trace::load(const string &fileName) {
+  ifstream in(fileName.c_str(), ios::binary);
+  char magic[sizeof(TRACE_MAGIC)] = {0};
+  uint32_t version = 0;
+  in.read(magic, sizeof(magic));
+  readInt(in, version);
+  if (!in || memcmp(magic, TRACE_MAGIC, sizeof(magic)) != 0 ||
+      version != TRACE_VERSION) {
+    cerr << fileName << " is no trace" << endl;
+    return false;
+  }
+
+  uint32_t timeStepBits;
+  uint8_t exactByte;
+  uint64_t numSteps;
+  readInt(in, seed);
+  readInt(in, timeStepBits);
+  readInt(in, exactByte);
+  readInt(in, numObjects);
+  readInt(in, numSteps);
+  memcpy(&timeStep, &timeStepBits, sizeof(timeStep));
+  exact = exactByte != 0;
+  states.clear();
+  for (uint64_t i = 0; in && i < numSteps * numObjects; ++i) {
+    ObjectState state;
+    for (int j = 0; j < 3; ++j)
+      readInt(in, state.position[j]);
+    for (int j = 0; j < 4; ++j)
+      readInt(in, state.orientation[j]);
+    readInt(in, state.colliding);
+    readInt(in, state.contacts);
+    states.push_back(state);
+  }
+  if (!in) {
+    cerr << "Trace " << fileName << " is incomplete" << endl;
+    states.clear();
+    return false;
+  }
+  return true;
+}
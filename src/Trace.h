@@ -0,0 +1,75 @@
+//
+//  Trace.h
+//  SphereOctree
+//
+
+#ifndef Trace_h
+#define Trace_h
+
+#include "World.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// A trace records the state of all objects of a world after each step: their
+// position, orientation and colliding leaves. Together with the seed and the
+// settings of the world, it is saved to a small binary file. Replaying the
+// same scene with these settings must give the same states bit for bit, so a
+// change of the code can be checked on the same work as before.
+class Trace {
+  // State of one object after a step.
+  struct ObjectState {
+    // Bits of the position and the orientation quaternion (w, x, y, z), so
+    // they are compared exactly.
+    uint32_t position[3];
+    uint32_t orientation[4];
+    uint8_t colliding;
+    // Hash of the sorted ids of the colliding leaves.
+    uint64_t contacts;
+  };
+
+  uint32_t seed = 0;
+  float timeStep = 0.0f;
+  bool exact = false;
+  uint32_t numObjects = 0;
+  // States of all objects, one step after the other.
+  std::vector<ObjectState> states;
+
+  // Returns the state of an object of the world.
+  static ObjectState getState(const WorldObject &obj);
+
+public:
+  Trace() {}
+
+  // Creates an empty trace with the seed and settings of the world.
+  Trace(const World &world);
+
+  // Appends the current states of all objects of the world.
+  void record(const World &world);
+
+  // Returns the index of the first object, whose state after the given step
+  // differs from the state in the world, or -1, if all of them are equal.
+  // @arg step: Index of a step, which was recorded
+  // @arg world: World with the same objects, which ran the same steps
+  int compare(size_t step, const World &world) const;
+
+  // Sets the seed and the settings of the trace for the world and resets it.
+  void apply(World &world) const;
+
+  // Writes the trace to a file. Returns false, if the file can not be written.
+  bool save(const std::string &fileName) const;
+
+  // Reads a trace written by save(). Returns false, if the file can not be
+  // read or is no trace.
+  bool load(const std::string &fileName);
+
+  inline size_t getNumSteps() const {
+    return numObjects == 0 ? 0 : states.size() / numObjects;
+  }
+  inline size_t getNumObjects() const { return numObjects; }
+  inline unsigned getSeed() const { return seed; }
+  inline float getTimeStep() const { return timeStep; }
+  inline bool getExact() const { return exact; }
+};
+
+#endif /* Trace_h */
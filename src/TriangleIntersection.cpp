@@ -0,0 +1,174 @@
+//
+//  TriangleIntersection.cpp
+//  SphereOctree
+//
+
+#include "TriangleIntersection.h"
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+
+namespace {
+
+// Distances below this value are treated as "on the plane".
+const float EPSILON = 1e-6f;
+
+// Returns true, if the 2D segments (a0, a1) and (b0, b1) intersect.
+bool segmentsIntersect(const Eigen::Vector2f &a0, const Eigen::Vector2f &a1,
+                       const Eigen::Vector2f &b0, const Eigen::Vector2f &b1) {
+  auto orient = [](const Eigen::Vector2f &a, const Eigen::Vector2f &b,
+                   const Eigen::Vector2f &c) {
+    return (b.x() - a.x()) * (c.y() - a.y()) -
+           (b.y() - a.y()) * (c.x() - a.x());
+  };
+  auto onSegment = [](const Eigen::Vector2f &a, const Eigen::Vector2f &b,
+                      const Eigen::Vector2f &p) {
+    return p.x() >= min(a.x(), b.x()) && p.x() <= max(a.x(), b.x()) &&
+           p.y() >= min(a.y(), b.y()) && p.y() <= max(a.y(), b.y());
+  };
+  float d1 = orient(b0, b1, a0);
+  float d2 = orient(b0, b1, a1);
+  float d3 = orient(a0, a1, b0);
+  float d4 = orient(a0, a1, b1);
+  if (((d1 > 0 && d2 < 0) || (d1 < 0 && d2 > 0)) &&
+      ((d3 > 0 && d4 < 0) || (d3 < 0 && d4 > 0)))
+    return true;
+  if (d1 == 0 && onSegment(b0, b1, a0))
+    return true;
+  if (d2 == 0 && onSegment(b0, b1, a1))
+    return true;
+  if (d3 == 0 && onSegment(a0, a1, b0))
+    return true;
+  if (d4 == 0 && onSegment(a0, a1, b1))
+    return true;
+  return false;
+}
+
+// Returns true, if the 2D point p lies in the triangle (a, b, c).
+bool pointInTriangle(const Eigen::Vector2f &p, const Eigen::Vector2f &a,
+                     const Eigen::Vector2f &b, const Eigen::Vector2f &c) {
+  auto side = [](const Eigen::Vector2f &u, const Eigen::Vector2f &v,
+                 const Eigen::Vector2f &w) {
+    return (v.x() - u.x()) * (w.y() - u.y()) -
+           (v.y() - u.y()) * (w.x() - u.x());
+  };
+  float s0 = side(a, b, p);
+  float s1 = side(b, c, p);
+  float s2 = side(c, a, p);
+  bool hasNeg = s0 < 0 || s1 < 0 || s2 < 0;
+  bool hasPos = s0 > 0 || s1 > 0 || s2 > 0;
+  return !(hasNeg && hasPos);
+}
+
+// Both triangles lie in the plane with normal n. Project them on the axis
+// aligned plane where they have the largest area and test them in 2D.
+bool coplanarIntersect(const Eigen::Vector3f &n, const Eigen::Vector3f *p,
+                       const Eigen::Vector3f *q) {
+  Eigen::Vector3f a = n.cwiseAbs();
+  int i0, i1;
+  if (a.x() > a.y() && a.x() > a.z()) {
+    i0 = 1;
+    i1 = 2;
+  } else if (a.y() > a.z()) {
+    i0 = 0;
+    i1 = 2;
+  } else {
+    i0 = 0;
+    i1 = 1;
+  }
+  Eigen::Vector2f p2[3], q2[3];
+  for (int i = 0; i < 3; ++i) {
+    p2[i] = Eigen::Vector2f(p[i](i0), p[i](i1));
+    q2[i] = Eigen::Vector2f(q[i](i0), q[i](i1));
+  }
+  for (int i = 0; i < 3; ++i) {
+    for (int j = 0; j < 3; ++j) {
+      if (segmentsIntersect(p2[i], p2[(i + 1) % 3], q2[j], q2[(j + 1) % 3]))
+        return true;
+    }
+  }
+  // No edges intersect, so one triangle is either completely inside the other
+  // one or they are disjoint.
+  return pointInTriangle(p2[0], q2[0], q2[1], q2[2]) ||
+         pointInTriangle(q2[0], p2[0], p2[1], p2[2]);
+}
+
+// Computes the interval, in which the triangle with the projected vertices
+// 'v' and the signed plane distances 'd' crosses the intersection line of
+// both planes. Returns false if the triangle lies in the other plane.
+bool computeInterval(const float *v, const float *d, float &t0, float &t1) {
+  // Find the vertex which lies alone on one side of the plane.
+  int alone;
+  if (d[0] * d[1] > 0.0f)
+    alone = 2;
+  else if (d[0] * d[2] > 0.0f)
+    alone = 1;
+  else if (d[1] * d[2] > 0.0f || d[0] != 0.0f)
+    alone = 0;
+  else if (d[1] != 0.0f)
+    alone = 1;
+  else if (d[2] != 0.0f)
+    alone = 2;
+  else
+    return false;
+
+  int a = (alone + 1) % 3;
+  int b = (alone + 2) % 3;
+  t0 = v[alone] + (v[a] - v[alone]) * d[alone] / (d[alone] - d[a]);
+  t1 = v[alone] + (v[b] - v[alone]) * d[alone] / (d[alone] - d[b]);
+  if (t0 > t1)
+    swap(t0, t1);
+  return true;
+}
+
+} // namespace
+
+bool trianglesIntersect(const Eigen::Vector3f &p0, const Eigen::Vector3f &p1,
+                        const Eigen::Vector3f &p2, const Eigen::Vector3f &q0,
+                        const Eigen::Vector3f &q1, const Eigen::Vector3f &q2) {
+  const Eigen::Vector3f p[3] = {p0, p1, p2};
+  const Eigen::Vector3f q[3] = {q0, q1, q2};
+
+  // Reject, if all vertices of p are on the same side of the plane of q.
+  Eigen::Vector3f n2 = (q1 - q0).cross(q2 - q0);
+  float d2 = -n2.dot(q0);
+  float dp[3];
+  for (int i = 0; i < 3; ++i) {
+    dp[i] = n2.dot(p[i]) + d2;
+    if (fabs(dp[i]) < EPSILON)
+      dp[i] = 0.0f;
+  }
+  if (dp[0] * dp[1] > 0.0f && dp[0] * dp[2] > 0.0f)
+    return false;
+
+  // Reject, if all vertices of q are on the same side of the plane of p.
+  Eigen::Vector3f n1 = (p1 - p0).cross(p2 - p0);
+  float d1 = -n1.dot(p0);
+  float dq[3];
+  for (int i = 0; i < 3; ++i) {
+    dq[i] = n1.dot(q[i]) + d1;
+    if (fabs(dq[i]) < EPSILON)
+      dq[i] = 0.0f;
+  }
+  if (dq[0] * dq[1] > 0.0f && dq[0] * dq[2] > 0.0f)
+    return false;
+
+  // Project the vertices on the largest axis of the intersection line.
+  Eigen::Vector3f D = n1.cross(n2);
+  int axis;
+  D.cwiseAbs().maxCoeff(&axis);
+  float vp[3], vq[3];
+  for (int i = 0; i < 3; ++i) {
+    vp[i] = p[i](axis);
+    vq[i] = q[i](axis);
+  }
+
+  float p0t, p1t, q0t, q1t;
+  if (!computeInterval(vp, dp, p0t, p1t))
+    return coplanarIntersect(n1, p, q);
+  if (!computeInterval(vq, dq, q0t, q1t))
+    return coplanarIntersect(n1, p, q);
+
+  return !(p1t < q0t || q1t < p0t);
+}
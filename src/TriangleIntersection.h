@@ -0,0 +1,20 @@
+//
+//  TriangleIntersection.h
+//  SphereOctree
+//
+
+#ifndef TriangleIntersection_h
+#define TriangleIntersection_h
+
+#define EIGEN_DONT_ALIGN_STATICALLY
+#include <Eigen/Dense>
+
+// Exact triangle-triangle intersection test after Moeller ("A Fast
+// Triangle-Triangle Intersection Test", 1997). Returns true, if the triangle
+// (p0, p1, p2) and the triangle (q0, q1, q2) intersect or touch, including the
+// coplanar case.
+bool trianglesIntersect(const Eigen::Vector3f &p0, const Eigen::Vector3f &p1,
+                        const Eigen::Vector3f &p2, const Eigen::Vector3f &q0,
+                        const Eigen::Vector3f &q1, const Eigen::Vector3f &q2);
+
+#endif /* TriangleIntersection_h */
@@ -0,0 +1,222 @@
+//
+//  World.cpp
+//  SphereOctree
+//
+
+#include "World.h"
+#include <algorithm>
+#include <numeric>
+
+using namespace std;
+
+// Number of steps an object must be at rest before its island can fall asleep,
+// so objects which only stop for a moment stay awake.
+static const size_t SLEEP_STEPS = 10;
+
+namespace {
+
+// Returns the root of the island of an object and shortens the path to it.
+size_t findIsland(vector<size_t> &parents, size_t i) {
+  while (parents[i] != i) {
+    parents[i] = parents[parents[i]];
+    i = parents[i];
+  }
+  return i;
+}
+
+} // namespace
+
+World::World(shared_ptr<ThreadPool> p, shared_ptr<Broadphase> b)
+    : pool(p), broadphase(b), bodies(make_shared<Bodies>()), random(seed) {}
+
+void World::add(shared_ptr<WorldObject> obj) {
+  obj->bind(bodies);
+  obj->init(random);
+  objects.push_back(obj);
+  bounds.push_back(obj->sweptBounds());
+  islands.push_back(objects.size() - 1);
+  restSteps.push_back(0);
+  sleeping.push_back(false);
+}
+
+void World::reset() {
+  random.seed(seed);
+  for (auto it = objects.begin(); it != objects.end(); ++it)
+    (*it)->init(random);
+  touching.clear();
+  events.clear();
+  for (size_t i = 0; i < objects.size(); ++i) {
+    islands[i] = i;
+    restSteps[i] = 0;
+    sleeping[i] = false;
+  }
+}
+
+void World::setSeed(unsigned s) {
+  seed = s;
+  reset();
+}
+
+void World::setTimeStep(float dt) { bodies->setTimeStep(dt); }
+
+bool World::step() {
+  // Only pairs whose boxes overlap can collide in this step. The boxes contain
+  // the whole movement, so they are used before and after it.
+  for (size_t i = 0; i < objects.size(); ++i) {
+    if (!sleeping[i])
+      bounds[i] = objects[i]->sweptBounds();
+  }
+  broadphase->update(bounds);
+  activePairs.clear();
+  const vector<Broadphase::Pair> &allPairs = broadphase->getPairs();
+  for (auto it = allPairs.begin(); it != allPairs.end(); ++it) {
+    if (!sleeping[it->first] || !sleeping[it->second])
+      activePairs.push_back(*it);
+  }
+  const vector<Broadphase::Pair> &pairs = activePairs;
+
+  // Only move each object until its first contact in this step, so fast
+  // objects can not move through each other.
+  vector<float> tois(pairs.size());
+  runPairs(pairs, vector<size_t>(pairs.size(), 1), [&](size_t i) {
+    tois[i] = objects[pairs[i].first]->timeOfImpact(objects[pairs[i].second]);
+  });
+  vector<float> fractions(objects.size(), 1.0f);
+  for (size_t i = 0; i < pairs.size(); ++i) {
+    fractions[pairs[i].first] = min(fractions[pairs[i].first], tois[i]);
+    fractions[pairs[i].second] = min(fractions[pairs[i].second], tois[i]);
+  }
+  // Colliding objects stay where they are.
+  for (size_t i = 0; i < objects.size(); ++i) {
+    if (objects[i]->getColliding())
+      fractions[i] = 0.0f;
+  }
+  bodies->integrate(fractions);
+  narrowphase(pairs);
+  updateIslands();
+  if (listener && !events.empty())
+    listener(events);
+
+  bool collision = true;
+  for (auto it = objects.begin(); it != objects.end(); ++it)
+    collision &= (*it)->getColliding();
+  return collision;
+}
+
+void World::runPairs(const vector<Broadphase::Pair> &pairs,
+                     const vector<size_t> &costs,
+                     function<void(size_t)> check) {
+  vector<size_t> order(pairs.size());
+  iota(order.begin(), order.end(), 0);
+  stable_sort(order.begin(), order.end(),
+              [&](size_t a, size_t b) { return costs[a] > costs[b]; });
+  size_t numBuckets = min(pairs.size(), 4 * pool->getNumThreads());
+  vector<vector<size_t>> buckets(numBuckets);
+  vector<size_t> load(numBuckets, 0);
+  for (auto it = order.begin(); it != order.end(); ++it) {
+    size_t bucket = min_element(load.begin(), load.end()) - load.begin();
+    buckets[bucket].push_back(*it);
+    load[bucket] += costs[*it] + 1;
+  }
+  vector<function<void()>> tasks;
+  for (auto it = buckets.begin(); it != buckets.end(); ++it) {
+    const vector<size_t> *bucket = &*it;
+    tasks.push_back([bucket, &check]() {
+      for (auto pair = bucket->begin(); pair != bucket->end(); ++pair)
+        check(*pair);
+    });
+  }
+  pool->run(tasks);
+}
+
+void World::narrowphase(const vector<Broadphase::Pair> &pairs) {
+  vector<ContactBuffer> contacts(pairs.size());
+  vector<char> collides(pairs.size(), 0);
+  for (auto it = pairs.begin(); it != pairs.end(); ++it)
+    objects[it->first]->prepareCheck(objects[it->second].get());
+
+  if (pairs.size() < pool->getNumThreads()) {
+    for (size_t i = 0; i < pairs.size(); ++i)
+      collides[i] = objects[pairs[i].first]->checkCollision(
+          objects[pairs[i].second], exact, contacts[i], pool);
+  } else {
+    vector<size_t> costs;
+    for (auto it = pairs.begin(); it != pairs.end(); ++it)
+      costs.push_back(objects[it->first]->checkCost(objects[it->second]));
+    // A pair with a large front splits its work on the pool as well, so it
+    // does not keep the other threads waiting.
+    runPairs(pairs, costs, [&](size_t i) {
+      collides[i] = objects[pairs[i].first]->checkCollision(
+          objects[pairs[i].second], exact, contacts[i], pool);
+    });
+  }
+
+  // The touching pairs of two sleeping objects were not checked and stay.
+  vector<Broadphase::Pair> lastTouching;
+  lastTouching.swap(touching);
+  for (auto it = lastTouching.begin(); it != lastTouching.end(); ++it) {
+    if (sleeping[it->first] && sleeping[it->second])
+      touching.push_back(*it);
+  }
+  events.clear();
+  for (size_t i = 0; i < pairs.size(); ++i) {
+    if (collides[i]) {
+      objects[pairs[i].first]->addContacts(objects[pairs[i].second],
+                                           contacts[i]);
+      touching.push_back(pairs[i]);
+      ContactEvent event;
+      event.type = binary_search(lastTouching.begin(), lastTouching.end(),
+                                 pairs[i])
+                       ? ContactEvent::PERSIST
+                       : ContactEvent::BEGIN;
+      event.objects = pairs[i];
+      events.push_back(event);
+      events.back().contacts.swap(contacts[i]);
+    }
+  }
+  sort(touching.begin(), touching.end());
+  for (auto it = lastTouching.begin(); it != lastTouching.end(); ++it) {
+    if (!binary_search(touching.begin(), touching.end(), *it)) {
+      ContactEvent event;
+      event.type = ContactEvent::END;
+      event.objects = *it;
+      events.push_back(event);
+    }
+  }
+}
+
+void World::updateIslands() {
+  for (size_t i = 0; i < objects.size(); ++i) {
+    islands[i] = i;
+    if (objects[i]->maxMovement() > 0.0f)
+      restSteps[i] = 0;
+    else if (restSteps[i] < SLEEP_STEPS)
+      ++restSteps[i];
+  }
+  for (auto it = touching.begin(); it != touching.end(); ++it)
+    islands[findIsland(islands, it->first)] = findIsland(islands, it->second);
+
+  // An island is awake, if one of its objects is awake.
+  vector<char> awake(objects.size(), 0);
+  for (size_t i = 0; i < objects.size(); ++i) {
+    islands[i] = findIsland(islands, i);
+    if (restSteps[i] < SLEEP_STEPS)
+      awake[islands[i]] = 1;
+  }
+  for (size_t i = 0; i < objects.size(); ++i)
+    sleeping[i] = !awake[islands[i]];
+}
+
+void World::wake(size_t index) {
+  size_t island = islands.at(index);
+  for (size_t i = 0; i < objects.size(); ++i) {
+    if (islands[i] == island) {
+      restSteps[i] = 0;
+      sleeping[i] = false;
+    }
+  }
+}
+
+size_t World::getNumAwake() const {
+  return count(sleeping.begin(), sleeping.end(), 0);
+}
@@ -0,0 +1,151 @@
+//
+//  World.h
+//  SphereOctree
+//
+
+#ifndef World_h
+#define World_h
+
+#include "Broadphase.h"
+#include "ThreadPool.h"
+#include "WorldObject.h"
+#include <functional>
+#include <memory>
+#include <random>
+#include <vector>
+
+// Default number of steps per second of the viewer and the headless
+// simulation.
+#define STEPS_PER_SECOND 1000.0f
+
+// A change of the contact between two objects in a step.
+struct ContactEvent {
+  enum Type {
+    // The objects collide, but did not collide in the last step.
+    BEGIN,
+    // The objects collided in the last step and still collide.
+    PERSIST,
+    // The objects collided in the last step, but do not collide anymore.
+    END
+  };
+  Type type;
+  // The indices of both objects, the first one is smaller.
+  Broadphase::Pair objects;
+  // The colliding leaf pairs, empty for END. The node ids of the leaves are the
+  // ones of the first and the second object.
+  ContactBuffer contacts;
+};
+
+// Receives the contact events of a step.
+typedef std::function<void(const std::vector<ContactEvent> &)> ContactListener;
+
+// The world moves all objects in steps and checks them for collisions. It does
+// not need OpenGL, so it is used by the viewer and the headless simulation.
+class World {
+  std::vector<std::shared_ptr<WorldObject>> objects;
+  std::shared_ptr<ThreadPool> pool;
+  std::shared_ptr<Broadphase> broadphase;
+  // Positions, velocities and rotations of all objects, moved together once
+  // per step.
+  std::shared_ptr<Bodies> bodies;
+  bool exact = false;
+  // Random numbers for the rotations of the objects, started with 'seed' by
+  // reset().
+  unsigned seed = 0;
+  std::mt19937 random;
+
+  // Swept boxes of the objects. The boxes of sleeping objects do not change.
+  std::vector<Eigen::AlignedBox3f> bounds;
+  // Pairs of the broadphase, without the ones of two sleeping objects.
+  std::vector<Broadphase::Pair> activePairs;
+  // Pairs which collided at their last check, sorted. Together they connect
+  // the objects to islands.
+  std::vector<Broadphase::Pair> touching;
+  // Contact events of the last step and the listener, which receives them.
+  std::vector<ContactEvent> events;
+  ContactListener listener;
+  // Island of each object, given by the index of one of its objects.
+  std::vector<size_t> islands;
+  // Number of steps, for which each object was at rest.
+  std::vector<size_t> restSteps;
+  // True, if the island of the object is asleep. Pairs of two sleeping
+  // objects are not checked, since neither of them moves.
+  std::vector<char> sleeping;
+
+  // Runs 'check' for the index of each pair on the pool. The pairs are put
+  // into a few buckets of about the same total cost, the most expensive pairs
+  // first, and each bucket is one task.
+  void runPairs(const std::vector<Broadphase::Pair> &pairs,
+                const std::vector<size_t> &costs,
+                std::function<void(size_t)> check);
+
+  // Checks all pairs for collisions. With more pairs than threads, the pairs
+  // are checked in parallel, and each check can split its work on the pool.
+  // The contacts are applied in the order of the pairs, so the result does not
+  // depend on the threads. Creates the contact events of the step.
+  void narrowphase(const std::vector<Broadphase::Pair> &pairs);
+
+  // Joins the objects of the touching pairs to islands. An island falls
+  // asleep, once all of its objects were at rest for a few steps, and is woken
+  // as a whole, if one of them moves.
+  void updateIslands();
+
+public:
+  // @arg pool: Threads for the collision checks
+  // @arg broadphase: Finds the object pairs to check
+  World(std::shared_ptr<ThreadPool> pool,
+        std::shared_ptr<Broadphase> broadphase);
+
+  // Adds an object. Its motion state becomes part of the bodies of the world
+  // and it is set to its start position.
+  void add(std::shared_ptr<WorldObject> obj);
+
+  // Sets all objects back to their start positions. The random numbers start
+  // with the seed again, so the objects get the same rotations as before.
+  void reset();
+
+  // Sets the seed of the random rotations and resets the objects with it. The
+  // same seed, objects and settings give the same steps bit for bit.
+  void setSeed(unsigned s);
+  inline unsigned getSeed() const { return seed; }
+
+  // Moves all objects by one time step and checks them for collisions.
+  // Returns true, if every object is colliding.
+  bool step();
+
+  // Sets the seconds simulated by one step for all objects. The step does not
+  // depend on the frame rate, so a viewer runs as many steps per frame as fit
+  // into the time of the frame.
+  void setTimeStep(float dt);
+  inline float getTimeStep() const { return bodies->getTimeStep(); }
+
+  // Wakes the island of an object, e.g. after it was changed from outside, so
+  // all pairs of its objects are checked again.
+  // @arg index: Index of the object
+  void wake(size_t index);
+
+  // Returns the number of objects, which are not asleep.
+  size_t getNumAwake() const;
+
+  // Sets a listener, which receives the contact events after each step, if
+  // there are any. The BEGIN and PERSIST events come in the order of the
+  // pairs, followed by the END events. Pairs of two sleeping objects do not
+  // get PERSIST events.
+  inline void setContactListener(ContactListener l) { listener = l; }
+
+  // Returns the contact events of the last step, for polling them instead of
+  // setting a listener.
+  inline const std::vector<ContactEvent> &getContactEvents() const {
+    return events;
+  }
+
+  inline void setBroadphase(std::shared_ptr<Broadphase> b) { broadphase = b; }
+  // If true, overlapping leaves are confirmed with a triangle test.
+  inline void setExact(bool e) { exact = e; }
+  inline bool getExact() const { return exact; }
+  inline const std::vector<std::shared_ptr<WorldObject>> &getObjects() const {
+    return objects;
+  }
+};
+
+#endif /* World_h */
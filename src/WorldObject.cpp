@@ -8,121 +8,204 @@
 
 #include "WorldObject.h"
 #include <chrono>
-#include <cstdlib>
+#include <cmath>
 #include <iostream>
+#include <limits>
 
 using namespace std;
 
-WorldObject::WorldObject(shared_ptr<Shape> objShape,
-                         shared_ptr<Shape> sphereShape,
-                         shared_ptr<Program> sProg, shared_ptr<Program> oProg,
-                         std::shared_ptr<Program> tProg, Eigen::Vector3f iPos,
-                         Eigen::Vector3f v, bool *keyToo)
-    : shape(objShape), sphere(sphereShape), shapeProg(sProg), octreeProg(oProg),
-      transProg(tProg), initialPosition(iPos), velocity(v), keyToogles(keyToo) {
+// Gap, by which conservative advancement moves at least in each iteration. The
+// objects overlap by at most this distance at the time of impact.
+static const float TOI_TOLERANCE = 1e-4f;
+// Maximum number of conservative advancement iterations per object pair.
+static const int TOI_MAX_ITERATIONS = 100;
+
+WorldObject::WorldObject(shared_ptr<Mesh> objMesh, Eigen::Vector3f iPos,
+                         Eigen::Vector3f v, shared_ptr<ThreadPool> pool)
+    : mesh(objMesh), bodies(make_shared<Bodies>()), index(bodies->add()),
+      initialPosition(iPos), velocity(v) {
   auto start = std::chrono::duration_cast<std::chrono::milliseconds>(
                    std::chrono::system_clock::now().time_since_epoch())
                    .count();
-  octree = make_shared<OctreeNode>(
+  auto root = make_shared<OctreeNode>(
       make_shared<BoundingBox>(Eigen::Vector3f(-1.0f, -1.0, 1.0f),
                                Eigen::Vector3f(1.0f, 1.0f, -1.0f)),
-      shape->getFaces(), TREE_DEEPNESS);
+      mesh->getFaces(), TREE_DEEPNESS, pool);
+  root->index(nodes);
+  octree = root;
+  markEpochs.assign(nodes.size(), 0);
   auto end = std::chrono::duration_cast<std::chrono::milliseconds>(
                  std::chrono::system_clock::now().time_since_epoch())
                  .count();
   cout << "Octree created in " << (end - start)
-       << "ms. (Faces: " << shape->getFaces()->size()
+       << "ms. (Faces: " << mesh->getFaces()->size()
        << ", Deepness: " << TREE_DEEPNESS
        << ", Child nodes: " << octree->getNumChildren() << ")" << endl;
 }
 
-void WorldObject::init() {
-  octree->resetColliding();
+WorldObject::WorldObject(shared_ptr<Mesh> objMesh,
+                         shared_ptr<const OctreeNode> objOctree,
+                         Eigen::Vector3f iPos, Eigen::Vector3f v)
+    : mesh(objMesh), octree(objOctree), bodies(make_shared<Bodies>()),
+      index(bodies->add()), initialPosition(iPos), velocity(v) {
+  octree->collect(nodes);
+  markEpochs.assign(nodes.size(), 0);
+}
+
+void WorldObject::bind(shared_ptr<Bodies> b) {
+  bodies = b;
+  index = bodies->add();
+}
+
+void WorldObject::init(mt19937 &random) {
+  collidingNodes.clear();
+  if (++epoch == 0) {
+    markEpochs.assign(nodes.size(), 0);
+    epoch = 1;
+  }
+  checks.clear();
   isColliding = false;
-  position = initialPosition;
-  int r = rand() % 3;
+  // The numbers of mt19937 are the same on every platform, the ones of the
+  // standard distributions are not.
+  int r = random() % 3;
+  Eigen::Vector3f axis;
   if (r == 0)
-    rotationVec = Eigen::Vector3f(1.0f, 0.0f, 0.0f);
+    axis = Eigen::Vector3f(1.0f, 0.0f, 0.0f);
   else if (r == 1)
-    rotationVec = Eigen::Vector3f(0.0f, 1.0f, 0.0f);
+    axis = Eigen::Vector3f(0.0f, 1.0f, 0.0f);
   else
-    rotationVec = Eigen::Vector3f(0.0f, 0.0f, 1.0f);
+    axis = Eigen::Vector3f(0.0f, 0.0f, 1.0f);
+
+  float angle = (random() % 360) * (float)M_PI / 180.0f;
+  // Up to 2 degrees per step at 60 steps per second
+  float rotation = (2 - (int)(random() % 5)) * 60.0f * (float)M_PI / 180.0f;
+  bodies->set(index, initialPosition, velocity,
+              Eigen::Quaternionf(Eigen::AngleAxisf(angle, axis)),
+              rotation * axis);
+}
+
+void WorldObject::move(float fraction) {
+  bodies->integrate(index, isColliding ? 0.0f : fraction);
+}
 
-  angle = rand() % 360;
-  rotation = 2 - (rand() % 5);
+void WorldObject::collisionDetection(shared_ptr<WorldObject> obj, bool exact,
+                                     shared_ptr<ThreadPool> pool) {
+  prepareCheck(obj.get());
+  contactBuffer.clear();
+  if (checkCollision(obj, exact, contactBuffer, pool))
+    addContacts(obj, contactBuffer);
 }
 
-void WorldObject::move() {
-  if (!isColliding) {
-    position += velocity;
-    angle += rotation;
-    angle = angle % 360;
+void WorldObject::prepareCheck(const WorldObject *obj) { checks[obj]; }
+
+bool WorldObject::checkCollision(shared_ptr<WorldObject> obj, bool exact,
+                                 ContactBuffer &contacts,
+                                 shared_ptr<ThreadPool> pool) {
+  PairCheck &check = checks.at(obj.get());
+  size_t steps = bodies->getSteps(index);
+  if (steps < check.nextCheck)
+    return false;
+
+  bool curCollision = check.front.update(
+      octree, obj->getOctree(), getTransform(), getInverseTransform(),
+      obj->getTransform(), exact, contacts, pool);
+
+  // Both objects together can close the gap by at most 'movement' per step,
+  // so they can not collide before 'nextCheck'. The step is counted by this
+  // object, so it stays valid, if the broadphase does not report the pair in
+  // the steps between.
+  if (!curCollision) {
+    float gap = octree->separation(*obj->getOctree(), getTransform(),
+                                   obj->getTransform());
+    float movement = maxMovement() + obj->maxMovement();
+    if (movement > 0.0f && gap / movement < numeric_limits<int>::max())
+      check.nextCheck = steps + max(1, (int)ceil(gap / movement));
+    else
+      check.nextCheck = numeric_limits<size_t>::max();
   }
+  return curCollision;
 }
 
-void WorldObject::collisionDetection(shared_ptr<WorldObject> obj) {
-  shared_ptr<MatrixStack> myStack = make_shared<MatrixStack>();
-  shared_ptr<MatrixStack> otherStack = make_shared<MatrixStack>();
-  addTransitionMatrix(myStack);
-  obj->addTransitionMatrix(otherStack);
-  bool curCollision = octree->checkCollision(
-      obj->getOctree(), make_shared<Eigen::Matrix4f>(myStack->topMatrix()),
-      make_shared<Eigen::Matrix4f>(otherStack->topMatrix()));
-  isColliding |= curCollision;
-  obj->isColliding |= curCollision;
-}
-
-void WorldObject::draw(std::shared_ptr<Camera> camera) const {
-  auto MV = make_shared<MatrixStack>();
-  auto P = make_shared<MatrixStack>();
-  camera->applyProjectionMatrix(P);
-  camera->applyViewMatrix(MV);
-
-  MV->pushMatrix();
-  addTransitionMatrix(MV);
-
-  shapeProg->bind();
-  glUniformMatrix4fv(shapeProg->getUniform("P"), 1, GL_FALSE,
-                     P->topMatrix().data());
-  glUniformMatrix4fv(shapeProg->getUniform("MV"), 1, GL_FALSE,
-                     MV->topMatrix().data());
-  shape->draw(shapeProg);
-  shapeProg->unbind();
-
-  // Draw all spheres on level
-  if (keyToogles[(unsigned)'s']) {
-    int level = 1;
-    for (int i = 0; i < 9; ++i) {
-      if (keyToogles[(unsigned)'1' + i])
-        level += i;
-    }
-    if (keyToogles[(unsigned)'0'])
-      level = TREE_DEEPNESS;
-    transProg->bind();
-    glUniformMatrix4fv(transProg->getUniform("P"), 1, GL_FALSE,
-                       P->topMatrix().data());
-    glUniformMatrix4fv(transProg->getUniform("MV"), 1, GL_FALSE,
-                       MV->topMatrix().data());
-    octree->drawLevel(transProg, sphere, level, MV);
-    transProg->unbind();
+void WorldObject::addContacts(shared_ptr<WorldObject> obj,
+                              const ContactBuffer &contacts) {
+  isColliding = true;
+  obj->isColliding = true;
+  for (auto it = contacts.begin(); it != contacts.end(); ++it) {
+    mark(it->myNode);
+    obj->mark(it->otherNode);
   }
-  // Draw colliding spheres only
-  else {
-    octreeProg->bind();
-    glUniformMatrix4fv(octreeProg->getUniform("P"), 1, GL_FALSE,
-                       P->topMatrix().data());
-    Eigen::Matrix3f T;
-    T(0) = TREE_DEEPNESS;
-    T(4) = TREE_DEEPNESS;
-    glUniformMatrix3fv(octreeProg->getUniform("T"), 1, GL_FALSE, T.data());
-    octree->drawColliding(octreeProg, sphere, MV);
-    octreeProg->unbind();
+}
+
+size_t WorldObject::checkCost(shared_ptr<WorldObject> obj) const {
+  auto check = checks.find(obj.get());
+  if (check == checks.end())
+    return 1;
+  if (bodies->getSteps(index) < check->second.nextCheck)
+    return 0;
+  return max<size_t>(1, check->second.front.size());
+}
+
+float WorldObject::separation(shared_ptr<WorldObject> obj,
+                              const OctreeNode **myClosest,
+                              const OctreeNode **otherClosest) const {
+  return octree->separation(*obj->getOctree(), getTransform(),
+                            obj->getTransform(), myClosest, otherClosest);
+}
+
+float WorldObject::timeOfImpact(shared_ptr<WorldObject> obj) const {
+  // The objects can not get closer than the gap in the next steps.
+  auto check = checks.find(obj.get());
+  if (check != checks.end() &&
+      bodies->getSteps(index) + 1 < check->second.nextCheck)
+    return numeric_limits<float>::infinity();
+  float movement = maxMovement() + obj->maxMovement();
+  if (movement <= 0.0f)
+    return numeric_limits<float>::infinity();
+
+  float t = 0.0f;
+  for (int i = 0; i < TOI_MAX_ITERATIONS; ++i) {
+    float gap = octree->separation(*obj->getOctree(), transitionMatrix(t),
+                                   obj->transitionMatrix(t));
+    if (gap <= 0.0f)
+      return i == 0 ? numeric_limits<float>::infinity() : t;
+    t += max(gap, TOI_TOLERANCE) / movement;
+    if (t > 1.0f)
+      return numeric_limits<float>::infinity();
   }
+  return t;
+}
 
-  MV->popMatrix();
+float WorldObject::maxMovement() const {
+  if (isColliding)
+    return 0.0f;
+  // A rotation by an angle moves a point at distance r from the origin by at
+  // most r times the angle in radians.
+  float reach = octree->getOrigin()->norm() + octree->getRadius();
+  return bodies->maxMovement(index, reach);
+}
+
+Eigen::AlignedBox3f WorldObject::sweptBounds() const {
+  const Eigen::Matrix4f &transform = getTransform();
+  Eigen::Vector3f center =
+      transform.topLeftCorner<3, 3>() * *octree->getOrigin() +
+      transform.topRightCorner<3, 1>();
+  Eigen::Vector3f extent =
+      Eigen::Vector3f::Constant(octree->getRadius() + maxMovement());
+  return Eigen::AlignedBox3f(center - extent, center + extent);
+}
+
+void WorldObject::addTransitionMatrix(shared_ptr<MatrixStack> m,
+                                      float alpha) const {
+  m->multMatrix(bodies->interpolate(index, alpha));
+}
+
+void WorldObject::mark(size_t id) {
+  if (markEpochs[id] != epoch) {
+    markEpochs[id] = epoch;
+    collidingNodes.push_back(id);
+  }
 }
 
-void WorldObject::addTransitionMatrix(shared_ptr<MatrixStack> m) const {
-  m->translate(position);
-  m->rotate(angle, rotationVec);
+Eigen::Matrix4f WorldObject::transitionMatrix(float fraction) const {
+  return bodies->predict(index, isColliding ? 0.0f : fraction);
 }
@@ -15,66 +15,194 @@
 #define EIGEN_DONT_ALIGN_STATICALLY
 #include <Eigen/Dense>
 
-#include "Camera.h"
+#include "Bodies.h"
+#include "CollisionFront.h"
 #include "MatrixStack.h"
+#include "Mesh.h"
 #include "OctreeNode.h"
-#include "Program.h"
-#include "Shape.h"
+#include "ThreadPool.h"
+#include <map>
 #include <memory>
+#include <random>
+#include <vector>
 
-// A world object contains its shape, the sphere shape, its position, the octree
-// node, and attributes and programs for drawing.
+// A world object contains its mesh, the octree node and the state of its
+// collision checks. Its position and rotation are an entry of a Bodies, shared
+// with the other objects of a world. It is drawn by an ObjectRenderer.
 class WorldObject {
-  std::shared_ptr<Shape> shape;
-  std::shared_ptr<Shape> sphere;
-  Eigen::Vector3f position;
-  std::shared_ptr<OctreeNode> octree;
-  std::shared_ptr<Program> shapeProg;
-  std::shared_ptr<Program> octreeProg;
-  std::shared_ptr<Program> transProg;
-  Eigen::Vector3f rotationVec;
+  std::shared_ptr<Mesh> mesh;
+  // Never changed after it is created, so it can be shared by objects with
+  // the same mesh.
+  std::shared_ptr<const OctreeNode> octree;
+  // Nodes of the octree, indexed by their id.
+  std::vector<const OctreeNode *> nodes;
+  // Ids of the leaves, which collided since the last init().
+  std::vector<size_t> collidingNodes;
+  // Epoch in which each node was added to collidingNodes. A node is marked,
+  // if its epoch is the current one, so init() clears all marks by starting a
+  // new epoch instead of visiting every node.
+  std::vector<unsigned> markEpochs;
+  unsigned epoch = 1;
+  // Reused by each collisionDetection() call.
+  ContactBuffer contactBuffer;
+  // The motion state of the object is the entry 'index' of 'bodies'.
+  std::shared_ptr<Bodies> bodies;
+  size_t index;
   Eigen::Vector3f initialPosition;
+  // Velocity in units per second.
   Eigen::Vector3f velocity;
-  int rotation;
-  int angle;
-  bool *keyToogles;
   bool isColliding = false;
 
+  // State of the collision checks with another object.
+  struct PairCheck {
+    // Collision front of the last check.
+    CollisionFront front;
+    // Step from which on the objects can collide again. The checks before are
+    // skipped, even if the broadphase reports the pair.
+    size_t nextCheck = 0;
+  };
+  std::map<const WorldObject *, PairCheck> checks;
+
+  // Returns the translation and rotation of the object after moving the given
+  // fraction of a step. The transform is only computed for a fraction other
+  // than 0.
+  Eigen::Matrix4f transitionMatrix(float fraction) const;
+
+  // Adds a leaf to the colliding nodes, if it is not marked yet.
+  void mark(size_t id);
+
 public:
-  // Creates an object of a given shape and inits it's sphere-octree.
-  // @arg shape: Shape of the object
-  // @arg sphere: Sphere shape
-  // @arg shapeProg: Program for drawing the object shape
-  // @arg octreeProg: Program for drawing the colliding spheres in the octree
-  // @arg transProg: Program for drawing all spheres on a level in the octree
+  // Creates an object of a given mesh and inits it's sphere-octree. Its motion
+  // state is kept in its own Bodies until bind() is called.
+  // @arg mesh: Mesh of the object
   // @arg initPosition: Initial position of the object
-  // @arg velocity: Velocity of the object per move() call
-  // @arg keyToogles: Pointer to [bool] key toogles
-  WorldObject(std::shared_ptr<Shape> shape, std::shared_ptr<Shape> sphere,
-              std::shared_ptr<Program> shapeProg,
-              std::shared_ptr<Program> octreeProg,
-              std::shared_ptr<Program> transProg, Eigen::Vector3f initPosition,
-              Eigen::Vector3f velocity, bool *keyToogles);
+  // @arg velocity: Velocity of the object in units per second
+  // @arg pool: If not null, the octree is created in parallel on this pool
+  WorldObject(std::shared_ptr<Mesh> mesh, Eigen::Vector3f initPosition,
+              Eigen::Vector3f velocity,
+              std::shared_ptr<ThreadPool> pool = nullptr);
+
+  // Creates an object, which uses the sphere-octree of another object with the
+  // same mesh instead of creating its own.
+  // @arg mesh: Mesh of the object
+  // @arg octree: Octree of the mesh, e.g. getOctree() of the other object
+  // @arg initPosition: Initial position of the object
+  // @arg velocity: Velocity of the object in units per second
+  WorldObject(std::shared_ptr<Mesh> mesh,
+              std::shared_ptr<const OctreeNode> octree,
+              Eigen::Vector3f initPosition, Eigen::Vector3f velocity);
+
+  // Inits the object. Is used to set it back to the start position. The
+  // rotation is chosen with the given random numbers, so the same seed gives
+  // the same rotations.
+  // @arg random: Random number generator
+  void init(std::mt19937 &random);
+
+  // Moves the motion state of the object into a new entry of the given
+  // bodies, so they move it together with their other objects. Must be called
+  // before init().
+  void bind(std::shared_ptr<Bodies> bodies);
+
+  // Moves and rotates the object by one time step. A World moves all of its
+  // objects at once with Bodies::integrate() instead.
+  // @arg fraction: Fraction of the time step to move
+  void move(float fraction = 1.0f);
+
+  // Check if the object is colliding with the other object. The check
+  // continues from the collision front of the last check with that object. If
+  // the objects are apart, the check is skipped for as many steps as they need
+  // to close the gap.
+  // @arg obj: The other object
+  // @arg exact: If true, overlapping leaves are confirmed with a triangle test
+  // @arg pool: If not null, the check of deeply overlapping objects is split
+  //            into tasks for this pool
+  void collisionDetection(std::shared_ptr<WorldObject> obj, bool exact = false,
+                          std::shared_ptr<ThreadPool> pool = nullptr);
+
+  // Creates the state of the checks with the other object, so checkCollision()
+  // does not change the list of checks.
+  void prepareCheck(const WorldObject *obj);
+
+  // Like collisionDetection(), but only the state of the prepared check with
+  // the other object is changed. The contacts are applied by addContacts().
+  // Thus the checks of different object pairs can run in parallel. Returns
+  // true, if the objects collide.
+  // @arg obj: The other object
+  // @arg exact: If true, overlapping leaves are confirmed with a triangle test
+  // @arg contacts: The colliding leaf pairs are appended to this buffer
+  // @arg pool: If not null, the check is split into tasks for this pool
+  bool checkCollision(std::shared_ptr<WorldObject> obj, bool exact,
+                      ContactBuffer &contacts,
+                      std::shared_ptr<ThreadPool> pool = nullptr);
+
+  // Marks this object and the other object as colliding and adds the leaves
+  // of the contacts to their colliding nodes.
+  // @arg obj: The other object
+  // @arg contacts: Contacts found by checkCollision() with the other object
+  void addContacts(std::shared_ptr<WorldObject> obj,
+                   const ContactBuffer &contacts);
+
+  // Returns an estimate of the work of the next check with the other object:
+  // the size of its collision front, 0 if the check is skipped.
+  size_t checkCost(std::shared_ptr<WorldObject> obj) const;
 
-  // Inits the object. Is used to set it back to the start position.
-  void init();
+  // Returns a lower bound of the gap between this object and the other one
+  // (0 if they collide).
+  // @arg obj: The other object
+  // @arg myClosest: If not null, set to the closest leaf of this object
+  // @arg otherClosest: If not null, set to the closest leaf of the other object
+  float separation(std::shared_ptr<WorldObject> obj,
+                   const OctreeNode **myClosest = nullptr,
+                   const OctreeNode **otherClosest = nullptr) const;
 
-  // Moves and rotates the object.
-  void move();
+  // Returns the fraction of the next step, at which this object and the other
+  // one collide first, if both move with their velocity and rotation. Uses
+  // conservative advancement: the objects are moved forward by the time they
+  // need at least to close the gap, until the gap is closed. Returns infinity,
+  // if they do not collide in the next step, or if their leaf spheres overlap
+  // already and only the triangle test can decide.
+  // @arg obj: The other object
+  float timeOfImpact(std::shared_ptr<WorldObject> obj) const;
 
-  // Check if the object is colliding with the other object.
-  void collisionDetection(std::shared_ptr<WorldObject> obj);
+  // Returns how far a point of the object can move at most in one move()
+  // call.
+  float maxMovement() const;
 
-  // Draws the colliding spheres or all spheres on a level, depending on the
-  // keyToogles.
-  void draw(std::shared_ptr<Camera> camera) const;
+  // Returns an axis aligned box around the root sphere of the octree, which
+  // contains the object during the whole next move() call.
+  Eigen::AlignedBox3f sweptBounds() const;
 
   // Adds the translation and rotation of the object to the matrix stack.
-  void addTransitionMatrix(std::shared_ptr<MatrixStack> m) const;
+  // @arg alpha: Fraction between the state before and after the last move(),
+  //             to draw the object between two steps
+  void addTransitionMatrix(std::shared_ptr<MatrixStack> m,
+                           float alpha = 1.0f) const;
 
-  inline std::shared_ptr<OctreeNode> getOctree() const { return octree; }
-  inline Eigen::Vector3f getPosition() const { return position; }
+  // Returns the translation and rotation of the object at its position.
+  inline const Eigen::Matrix4f &getTransform() const {
+    return bodies->getTransform(index);
+  }
+  // Returns the inverse of getTransform().
+  inline const Eigen::Matrix4f &getInverseTransform() const {
+    return bodies->getInverse(index);
+  }
+  inline std::shared_ptr<Mesh> getMesh() const { return mesh; }
+  inline std::shared_ptr<const OctreeNode> getOctree() const {
+    return octree;
+  }
+  // Returns the node of the octree with the given id.
+  inline const OctreeNode &getNode(size_t id) const { return *nodes[id]; }
+  inline Eigen::Vector3f getPosition() const {
+    return bodies->getPosition(index);
+  }
+  inline Eigen::Quaternionf getOrientation() const {
+    return bodies->getOrientation(index);
+  }
   inline bool getColliding() const { return isColliding; }
+  // Returns the ids of the colliding leaves, see OctreeNode::getId().
+  inline const std::vector<size_t> &getCollidingNodes() const {
+    return collidingNodes;
+  }
 };
 
 #endif /* WorldObject_h */
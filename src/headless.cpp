@@ -0,0 +1,208 @@
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#define EIGEN_DONT_ALIGN_STATICALLY
+#include <Eigen/Dense>
+
+#include "DynamicTree.h"
+#include "Mesh.h"
+#include "SpatialHashGrid.h"
+#include "SweepAndPrune.h"
+#include "ThreadPool.h"
+#include "Trace.h"
+#include "World.h"
+#include "WorldObject.h"
+
+using namespace std;
+using namespace Eigen;
+
+// Runs the simulation of the viewer without a window and prints the collisions
+// and the time per step.
+static void usage() {
+    cout << "Usage: SphereOctreeHeadless RESOURCE_DIR [-steps N] [-exact]"
+         << " [-events] [-broadphase sap|grid|tree] [-threads N] [-rate N]"
+         << " [-seed N] [-record FILE | -replay FILE]" << endl;
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        usage();
+        return 0;
+    }
+    string resourceDir = argv[1] + string("/");
+    int steps = 5000;
+    bool exact = false;
+    bool printEvents = false;
+    string broadphaseName = "sap";
+    size_t threads = 0;
+    float rate = STEPS_PER_SECOND;
+    unsigned seed = 0;
+    string recordFile;
+    string replayFile;
+    for (int i = 2; i < argc; ++i) {
+        if (strcmp(argv[i], "-steps") == 0 && i + 1 < argc) {
+            steps = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-exact") == 0) {
+            exact = true;
+        } else if (strcmp(argv[i], "-events") == 0) {
+            printEvents = true;
+        } else if (strcmp(argv[i], "-broadphase") == 0 && i + 1 < argc) {
+            broadphaseName = argv[++i];
+        } else if (strcmp(argv[i], "-threads") == 0 && i + 1 < argc) {
+            int n = atoi(argv[++i]);
+            if (n < 0) {
+                usage();
+                return 1;
+            }
+            threads = n;
+        } else if (strcmp(argv[i], "-rate") == 0 && i + 1 < argc) {
+            rate = (float)atof(argv[++i]);
+            if (rate <= 0.0f) {
+                usage();
+                return 1;
+            }
+        } else if (strcmp(argv[i], "-seed") == 0 && i + 1 < argc) {
+            seed = (unsigned)strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "-record") == 0 && i + 1 < argc) {
+            recordFile = argv[++i];
+        } else if (strcmp(argv[i], "-replay") == 0 && i + 1 < argc) {
+            replayFile = argv[++i];
+        } else {
+            usage();
+            return 1;
+        }
+    }
+    if (!recordFile.empty() && !replayFile.empty()) {
+        usage();
+        return 1;
+    }
+
+    shared_ptr<Broadphase> broadphase;
+    if (broadphaseName == "sap") {
+        broadphase = make_shared<SweepAndPrune>();
+    } else if (broadphaseName == "grid") {
+        broadphase = make_shared<SpatialHashGrid>();
+    } else if (broadphaseName == "tree") {
+        broadphase = make_shared<DynamicTree>();
+    } else {
+        usage();
+        return 1;
+    }
+
+    // One pool for loading, creating the octrees and the steps
+    auto pool = make_shared<ThreadPool>(threads);
+
+    // Load meshes in parallel
+    auto bunny = make_shared<Mesh>();
+    auto teapot = make_shared<Mesh>();
+    shared_ptr<Mesh> meshes[] = {bunny, teapot};
+    string meshNames[] = {"bunny.obj", "teapot.obj"};
+    bool loaded[] = {false, false};
+    pool->parallelFor(0, 2, [&](size_t i) {
+        loaded[i] = meshes[i]->loadMesh(resourceDir + meshNames[i]);
+        meshes[i]->fitToUnitBox();
+    });
+    for (size_t i = 0; i < 2; ++i) {
+        if (!loaded[i]) {
+            cerr << "Cannot load " << meshNames[i] << " from " << resourceDir
+                 << endl;
+            return 1;
+        }
+    }
+
+    // The same three objects as in the viewer
+    World world(pool, broadphase);
+    world.setExact(exact);
+    world.setTimeStep(1.0f / rate);
+    world.setSeed(seed);
+    auto firstBunny = make_shared<WorldObject>(
+        bunny, Vector3f(-2.0f, -1.0f, 0.0f), Vector3f(0.6f, 0.06f, 0.0f), pool);
+    world.add(firstBunny);
+    world.add(make_shared<WorldObject>(teapot, Vector3f(2.0f, -0.8f, 0.0f),
+                                       Vector3f(-0.6f, 0.03f, 0.0f), pool));
+    // The second bunny uses the octree of the first one.
+    world.add(make_shared<WorldObject>(bunny, firstBunny->getOctree(),
+                                       Vector3f(0.0f, 1.0f, 0.0f),
+                                       Vector3f(0.0f, -0.3f, 0.0f)));
+
+    // A replay runs the recorded steps with the settings of the trace.
+    Trace trace(world);
+    if (!replayFile.empty()) {
+        if (!trace.load(replayFile))
+            return 1;
+        if (trace.getNumObjects() != world.getObjects().size()) {
+            cerr << "The trace has " << trace.getNumObjects()
+                 << " objects instead of " << world.getObjects().size() << endl;
+            return 1;
+        }
+        trace.apply(world);
+        steps = (int)trace.getNumSteps() - 1;
+        rate = 1.0f / trace.getTimeStep();
+        cout << "Replaying " << steps << " steps with seed "
+             << trace.getSeed() << endl;
+    } else if (!recordFile.empty()) {
+        trace.record(world);
+    }
+
+    // Run until every object collides, like the viewer
+    const vector<shared_ptr<WorldObject>> &objs = world.getObjects();
+    size_t colliding = 0;
+    int step = 0;
+    bool collision = false;
+    if (printEvents) {
+        world.setContactListener([&step](const vector<ContactEvent> &events) {
+            for (auto it = events.begin(); it != events.end(); ++it) {
+                if (it->type == ContactEvent::PERSIST)
+                    continue;
+                cout << "Step " << step + 1 << ": objects "
+                     << it->objects.first << " and " << it->objects.second
+                     << (it->type == ContactEvent::BEGIN ? " begin" : " end")
+                     << " to collide";
+                if (it->type == ContactEvent::BEGIN)
+                    cout << " (" << it->contacts.size() << " leaf pairs)";
+                cout << endl;
+            }
+        });
+    }
+    auto start = chrono::steady_clock::now();
+    while (step < steps && (!collision || !replayFile.empty())) {
+        collision = world.step();
+        ++step;
+        if (!replayFile.empty()) {
+            int object = trace.compare(step, world);
+            if (object >= 0) {
+                cout << "Replay differs at step " << step << " in object "
+                     << object << "." << endl;
+                return 1;
+            }
+        } else if (!recordFile.empty()) {
+            trace.record(world);
+        }
+        size_t count = 0;
+        for (auto it = objs.begin(); it != objs.end(); ++it)
+            count += (*it)->getColliding();
+        if (count != colliding) {
+            cout << "Step " << step << ": " << count << " of " << objs.size()
+                 << " objects colliding" << endl;
+            colliding = count;
+        }
+    }
+    double ms = chrono::duration<double, milli>(chrono::steady_clock::now() -
+                                                start).count();
+    cout << step << " steps (" << step / rate << "s) in " << ms << "ms ("
+         << ms / max(step, 1) << "ms per step). "
+         << (collision ? "All objects collide." : "Not all objects collide.")
+         << endl;
+
+    if (!replayFile.empty()) {
+        cout << "Replay matches the trace." << endl;
+    } else if (!recordFile.empty()) {
+        if (!trace.save(recordFile))
+            return 1;
+        cout << "Recorded " << step << " steps with seed " << seed << " to "
+             << recordFile << endl;
+    }
+    return 0;
+}
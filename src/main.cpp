@@ -1,4 +1,5 @@
 #include <cassert>
+#include <cstdlib>
 #include <cstring>
 #define _USE_MATH_DEFINES
 #include <cmath>
@@ -11,13 +12,21 @@
 #define EIGEN_DONT_ALIGN_STATICALLY
 #include <Eigen/Dense>
 
+#include "Broadphase.h"
 #include "Camera.h"
+#include "DynamicTree.h"
 #include "GLSL.h"
 #include "MatrixStack.h"
+#include "ObjectRenderer.h"
 #include "OctreeNode.h"
 #include "Program.h"
 #include "Shape.h"
+#include "SpatialHashGrid.h"
+#include "SweepAndPrune.h"
 #include "Texture.h"
+#include "Simulation.h"
+#include "ThreadPool.h"
+#include "World.h"
 #include "WorldObject.h"
 
 using namespace std;
@@ -33,12 +42,28 @@ shared_ptr<Program> transProg;
 shared_ptr<Shape> bunny; // This saves the bunny shape
 shared_ptr<Shape> sphere; // This saves the sphere shape
 shared_ptr<Shape> teapot; // This saves the teapot shape
-vector<shared_ptr<WorldObject>> objs; // This saves the world objects (this includes shape and octree)
+vector<shared_ptr<Shape>> sphereLods; // Coarser spheres for small spheres
+shared_ptr<World> world; // This saves the world objects (this includes mesh and octree)
+shared_ptr<Simulation> simulation; // Runs the steps of the world on its own thread
+vector<shared_ptr<ObjectRenderer>> renderers; // Draws each world object
+shared_ptr<ThreadPool> pool; // Worker threads for the collision detection
+shared_ptr<Broadphase> sweepAndPrune; // Finds the object pairs to check
+shared_ptr<Broadphase> hashGrid; // Alternative for many objects of one size
+shared_ptr<Broadphase> tree; // Alternative for static and dynamic objects
 shared_ptr<Texture> gridTex;
+GLint gridTexUniform; // Handle of the uniform "texture" of silProg
 
 bool keyToggles[256] = {false}; // only for English keyboards!
 bool collision = false;
 
+// Simulated steps per second. The simulation does not depend on the frame
+// rate, each frame runs the steps for the time since the last frame.
+float stepsPerSecond = STEPS_PER_SECOND;
+// Steps per frame at most. If the simulation is slower, it falls behind the
+// real time instead of taking longer and longer for each frame.
+const int MAX_STEPS_PER_FRAME = 100;
+double lastTime = 0.0; // Time of the last frame
+
 // This function is called when a GLFW error occurs.
 static void error_callback(int error, const char *description) {
     cerr << description << endl;
@@ -90,8 +115,9 @@ static void resize_callback(GLFWwindow *window, int width, int height) {
     glViewport(0, 0, width, height);
 }
 
-// This function is called once to initialize the scene and OpenGL.
-static void init() {
+// This function is called once to initialize the scene and OpenGL. Returns
+// false, if a mesh can not be loaded.
+static bool init() {
     // Initialize time.
     glfwSetTime(0.0);
 
@@ -112,47 +138,74 @@ static void init() {
     prog->addUniform("P");
 
     silProg = make_shared<Program>();
-    silProg->setShaderNames(RESOURCE_DIR + "vert.glsl",
+    silProg->setShaderNames(RESOURCE_DIR + "vertInst.glsl",
                             RESOURCE_DIR + "fragGrid.glsl");
     silProg->setVerbose(true);
     silProg->init();
     silProg->addAttribute("aPos");
     silProg->addAttribute("aNor");
     silProg->addAttribute("aTex");
+    silProg->addAttribute("aInst");
     silProg->addUniform("MV");
     silProg->addUniform("P");
     silProg->addUniform("T");
     silProg->addUniform("texture");
+    gridTexUniform = silProg->getUniform("texture");
 
     transProg = make_shared<Program>();
-    transProg->setShaderNames(RESOURCE_DIR + "vert.glsl",
+    transProg->setShaderNames(RESOURCE_DIR + "vertInst.glsl",
                               RESOURCE_DIR + "fragTrans.glsl");
     transProg->setVerbose(true);
     transProg->init();
     transProg->addAttribute("aPos");
     transProg->addAttribute("aNor");
     transProg->addAttribute("aTex");
+    transProg->addAttribute("aInst");
     transProg->addUniform("MV");
     transProg->addUniform("P");
 
     // Set camera
     camera = make_shared<Camera>();
 
-    // Load meshes
-    bunny = make_shared<Shape>();
-    bunny->loadMesh(RESOURCE_DIR + "bunny.obj");
-    bunny->fitToUnitBox();
-    bunny->init();
+    // One thread per core for loading, the octrees and the collision detection
+    pool = make_shared<ThreadPool>();
+    sweepAndPrune = make_shared<SweepAndPrune>();
+    hashGrid = make_shared<SpatialHashGrid>();
+    tree = make_shared<DynamicTree>();
+    world = make_shared<World>(pool, sweepAndPrune);
+    world->setTimeStep(1.0f / stepsPerSecond);
 
+    // Load meshes in parallel. Their buffers are created on this thread, which
+    // has the OpenGL context.
+    bunny = make_shared<Shape>();
     sphere = make_shared<Shape>();
-    sphere->loadMesh(RESOURCE_DIR + "sphere.obj");
-    sphere->fitToUnitBox();
-    sphere->init();
-
     teapot = make_shared<Shape>();
-    teapot->loadMesh(RESOURCE_DIR + "teapot.obj");
-    teapot->fitToUnitBox();
-    teapot->init();
+    shared_ptr<Shape> shapes[] = {bunny, sphere, teapot};
+    string shapeNames[] = {"bunny.obj", "sphere.obj", "teapot.obj"};
+    bool loaded[] = {false, false, false};
+    pool->parallelFor(0, 3, [&](size_t i) {
+        loaded[i] = shapes[i]->loadMesh(RESOURCE_DIR + shapeNames[i]);
+        shapes[i]->fitToUnitBox();
+    });
+    for (size_t i = 0; i < 3; ++i) {
+        if (!loaded[i]) {
+            cerr << "Cannot load " << shapeNames[i] << " from "
+                 << RESOURCE_DIR << endl;
+            return false;
+        }
+    }
+    for (size_t i = 0; i < 3; ++i)
+        shapes[i]->init();
+
+    // Coarser spheres with 8, 48 and 224 triangles for the spheres which
+    // cover only a few pixels, e.g. on the deepest levels.
+    int lodRings[] = {2, 4, 8};
+    for (size_t i = 0; i < 3; ++i) {
+        auto lod = make_shared<Shape>();
+        lod->createSphere(lodRings[i], 2 * lodRings[i]);
+        lod->init();
+        sphereLods.push_back(lod);
+    }
 
     // Texture
     gridTex = make_shared<Texture>();
@@ -162,32 +215,58 @@ static void init() {
     gridTex->setWrapModes(GL_REPEAT, GL_REPEAT);
 
     // Create our three world objects (including octrees)
-    auto o = make_shared<WorldObject>(bunny, sphere, prog, silProg, transProg,
-                                      Vector3f(-2.0f, -1.0f, 0.0f), // Position
-                                      Vector3f(0.01f, 0.001f, 0.0f), // Velocity
-                                      keyToggles);
-    o->init();
-    objs.push_back(o);
-
-    o = make_shared<WorldObject>(teapot, sphere, prog, silProg, transProg,
-                                 Vector3f(2.0f, -0.8f, 0.0f), // Position
-                                 Vector3f(-0.01f, 0.0005f, 0.0f), // Velocity
-                                 keyToggles);
-    o->init();
-    objs.push_back(o);
-
-    o = make_shared<WorldObject>(bunny, sphere, prog, silProg, transProg,
-                                 Vector3f(0.0f, 1.0f, 0.0f), // Position
-                                 Vector3f(0.0f, -0.005f, 0.0f), // Velocity
-                                 keyToggles);
-    o->init();
-    objs.push_back(o);
+    auto firstBunny = make_shared<WorldObject>(bunny,
+                                        Vector3f(-2.0f, -1.0f, 0.0f), // Position
+                                        Vector3f(0.6f, 0.06f, 0.0f), // Velocity
+                                        pool);
+    world->add(firstBunny);
+    renderers.push_back(make_shared<ObjectRenderer>(bunny, sphere, prog, silProg,
+                                                    transProg, keyToggles));
+
+    world->add(make_shared<WorldObject>(teapot,
+                                        Vector3f(2.0f, -0.8f, 0.0f), // Position
+                                        Vector3f(-0.6f, 0.03f, 0.0f), // Velocity
+                                        pool));
+    renderers.push_back(make_shared<ObjectRenderer>(teapot, sphere, prog, silProg,
+                                                    transProg, keyToggles));
+
+    // The second bunny uses the octree of the first one.
+    world->add(make_shared<WorldObject>(bunny, firstBunny->getOctree(),
+                                        Vector3f(0.0f, 1.0f, 0.0f), // Position
+                                        Vector3f(0.0f, -0.3f, 0.0f))); // Velocity
+    renderers.push_back(make_shared<ObjectRenderer>(bunny, sphere, prog, silProg,
+                                                    transProg, keyToggles));
+
+    // Largest projected radius in pixels of each coarser sphere
+    float lodPixels[] = {2.0f, 6.0f, 20.0f};
+    for (auto it = renderers.begin(); it != renderers.end(); ++it) {
+        for (size_t i = 0; i < sphereLods.size(); ++i)
+            (*it)->addSphereLod(sphereLods[i], lodPixels[i]);
+    }
+
+    // Run the steps on their own thread from now on
+    simulation = make_shared<Simulation>(world, MAX_STEPS_PER_FRAME);
 
     GLSL::checkError(GET_FILE_LINE);
+    return true;
+}
+
+// Deletes the renderers and shapes, which own OpenGL buffers, while the
+// context is still current. As globals, they would only be destroyed after
+// the window. The objects of the world use the shapes as their meshes, so the
+// world is deleted, too. The simulation must be stopped before.
+static void release() {
+    renderers.clear();
+    world.reset();
+    sphereLods.clear();
+    bunny.reset();
+    sphere.reset();
+    teapot.reset();
 }
 
 // This function is called every frame to draw the scene.
-static void render() {
+// @arg snapshot: State of the objects after the last steps
+static void render(const Snapshot &snapshot) {
     // Clear framebuffer.
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
     if (keyToggles[(unsigned)'c']) {
@@ -208,37 +287,50 @@ static void render() {
 
     // Draw our objects
     silProg->bind();
-    gridTex->bind(silProg->getUniform("texture"));
+    gridTex->bind(gridTexUniform);
     silProg->unbind();
-    for (auto it = objs.begin(); it != objs.end(); ++it)
-        (*it)->draw(camera);
+    const vector<shared_ptr<WorldObject>> &objs = world->getObjects();
+    for (size_t i = 0; i < objs.size(); ++i)
+        renderers.at(i)->draw(*objs.at(i), snapshot.objects.at(i), camera);
 
     GLSL::checkError(GET_FILE_LINE);
 }
 
-// Execute a movement step for the objects, if the user did not pause and there
-// is no collision
+// Start the movement steps for the time since the last frame, if the user did
+// not pause and there is no collision. The steps run on the simulation thread,
+// while the last frame is drawn.
 void step() {
+    double time = glfwGetTime();
+    double frameTime = time - lastTime;
+    lastTime = time;
+
+    // The world can only be changed, when the last steps are done
+    simulation->wait();
+    // Pause once every object collides
+    if (simulation->getSnapshot().collision && !collision)
+        keyToggles[(unsigned)' '] = false;
+    collision = simulation->getSnapshot().collision;
+
     // Move every object and check for collisions
     if (keyToggles[(unsigned)' '] && !collision) {
-        for (size_t current = 0; current < objs.size(); ++current) {
-            objs.at(current)->move();
-            for (size_t next = current + 1; next < objs.size(); ++next)
-                objs.at(current)->collisionDetection(objs.at(next));
-        }
-
-        collision = true;
-        for (size_t current = 0; current < objs.size(); ++current)
-            collision &= objs.at(current)->getColliding();
-        keyToggles[(unsigned)' '] = !collision;
+        if (keyToggles[(unsigned)'h'])
+            world->setBroadphase(hashGrid);
+        else if (keyToggles[(unsigned)'b'])
+            world->setBroadphase(tree);
+        else
+            world->setBroadphase(sweepAndPrune);
+        world->setExact(keyToggles[(unsigned)'t']);
+        simulation->start(frameTime);
     }
 
     // If the current scene stopped, because every object was colliding, and the
-    // user presses space again, then reset the scene.
+    // user presses space again, then reset the scene with the next seed, so the
+    // objects rotate differently.
     if (keyToggles[(unsigned)' '] && collision) {
         keyToggles[(unsigned)' '] = false;
-        for (auto it = objs.begin(); it != objs.end(); ++it)
-            (*it)->init();
+        world->setSeed(world->getSeed() + 1);
+        cout << "Seed: " << world->getSeed() << endl;
+        simulation->restart();
         collision = false;
     }
 }
@@ -249,6 +341,10 @@ int main(int argc, char **argv) {
         return 0;
     }
     RESOURCE_DIR = argv[1] + string("/");
+    // Optionally, the steps per second can be given.
+    if (argc > 2 && atof(argv[2]) > 0.0) {
+        stepsPerSecond = (float)atof(argv[2]);
+    }
 
     // Set error callback.
     glfwSetErrorCallback(error_callback);
@@ -293,18 +389,26 @@ int main(int argc, char **argv) {
 
     // Initialize scene.
     cout << "Creating scene and objects with sphere-octrees." << endl;
-    init();
+    if (!init()) {
+        release();
+        glfwDestroyWindow(window);
+        glfwTerminate();
+        return -1;
+    }
     // Loop until the user closes the window.
+    lastTime = glfwGetTime();
     while (!glfwWindowShouldClose(window)) {
         step();
         // Render scene.
-        render();
+        render(simulation->getSnapshot());
         // Swap front and back buffers.
         glfwSwapBuffers(window);
         // Poll for and process events.
         glfwPollEvents();
     }
     // Quit program.
+    simulation.reset();
+    release();
     glfwDestroyWindow(window);
     glfwTerminate();
     return 0;
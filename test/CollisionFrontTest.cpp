@@ -0,0 +1,140 @@
+//
+//  CollisionFrontTest.cpp
+//  SphereOctree
+//
+
+// Moves a teapot through a bunny and compares the contacts of the collision
+// front in each frame with the ones of a full OctreeNode::checkCollision()
+// traversal, once updated on one thread and once split on a pool. The gap of
+// OctreeNode::separation() must be 0 exactly in the frames with contacts.
+
+#include "CollisionFront.h"
+#include "Mesh.h"
+#include "MatrixStack.h"
+#include "OctreeNode.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// Levels of the test octrees, less than in the viewer to keep the test fast.
+static const size_t DEEPNESS = 6;
+static const int FRAMES = 120;
+
+namespace {
+
+// Returns the octree of a mesh, null if the mesh can not be loaded.
+shared_ptr<OctreeNode> loadOctree(const string &fileName,
+                                  vector<const OctreeNode *> &nodes) {
+  Mesh mesh;
+  if (!mesh.loadMesh(fileName))
+    return nullptr;
+  mesh.fitToUnitBox();
+  auto octree = make_shared<OctreeNode>(
+      make_shared<BoundingBox>(Eigen::Vector3f(-1.0f, -1.0f, 1.0f),
+                               Eigen::Vector3f(1.0f, 1.0f, -1.0f)),
+      mesh.getFaces(), DEEPNESS);
+  octree->index(nodes);
+  return octree;
+}
+
+// Returns the node id pairs of the contacts in their order.
+vector<pair<size_t, size_t>> idPairs(const ContactBuffer &contacts) {
+  vector<pair<size_t, size_t>> result;
+  for (auto it = contacts.begin(); it != contacts.end(); ++it)
+    result.push_back(make_pair(it->myNode, it->otherNode));
+  return result;
+}
+
+// Returns the node id pairs of the contacts sorted, so contacts found in
+// another order compare equal.
+vector<pair<size_t, size_t>> sorted(const ContactBuffer &contacts) {
+  vector<pair<size_t, size_t>> result = idPairs(contacts);
+  sort(result.begin(), result.end());
+  return result;
+}
+
+// Returns the position of the teapot in a frame. It grazes the top of the
+// bunny while it rotates. There leaf spheres, which stick out of the spheres
+// above them, overlap while the spheres above are apart.
+Eigen::Matrix4f teapotPosition(int frame) {
+  float t = (float)frame / FRAMES;
+  MatrixStack m;
+  m.translate(Eigen::Vector3f(1.5f - 3.0f * t, 0.5f, 0.0f));
+  m.rotate(180.0f * t, Eigen::Vector3f(0.3f, 1.0f, 0.2f).normalized());
+  return m.topMatrix();
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    cout << "Please specify the resource directory." << endl;
+    return 1;
+  }
+  string resources = string(argv[1]) + "/";
+  vector<const OctreeNode *> bunnyNodes, teapotNodes;
+  shared_ptr<OctreeNode> bunny =
+      loadOctree(resources + "bunny.obj", bunnyNodes);
+  shared_ptr<OctreeNode> teapot =
+      loadOctree(resources + "teapot.obj", teapotNodes);
+  if (bunny == nullptr || teapot == nullptr) {
+    cout << "Cannot load the meshes from " << resources << endl;
+    return 1;
+  }
+  auto pool = make_shared<ThreadPool>(4);
+
+  int failures = 0;
+  for (int exact = 0; exact < 2; ++exact) {
+    CollisionFront front, parallel;
+    // The triangle test is slow, so only a few frames are checked with it.
+    int frames = exact ? 3 : FRAMES;
+    for (int frame = 0; frame <= frames; ++frame) {
+      Eigen::Matrix4f bunnyPosition = Eigen::Matrix4f::Identity();
+      Eigen::Matrix4f position = teapotPosition(frame * (FRAMES / frames));
+      ContactBuffer expected, fromFront, fromParallel;
+      bunny->checkCollision(*teapot, bunnyPosition, position, exact != 0,
+                            expected);
+      front.update(bunny, teapot, bunnyPosition, bunnyPosition, position,
+                   exact != 0, fromFront);
+      parallel.update(bunny, teapot, bunnyPosition, bunnyPosition, position,
+                      exact != 0, fromParallel, pool);
+      if (sorted(fromFront) != sorted(expected)) {
+        cout << "Frame " << frame << (exact ? " (exact)" : "")
+             << ": front has " << fromFront.size()
+             << " contacts, checkCollision() " << expected.size() << endl;
+        ++failures;
+      }
+      // Without the triangle test, the leaf spheres are only apart if
+      // separation() finds a gap.
+      float gap = bunny->separation(*teapot, bunnyPosition, position);
+      if (!exact && (gap == 0.0f) != !expected.empty()) {
+        cout << "Frame " << frame << ": separation() is " << gap
+             << ", checkCollision() found " << expected.size() << " contacts"
+             << endl;
+        ++failures;
+      }
+      // Split on the pool, the front must have the same pairs and give the
+      // same contacts in the same order.
+      if (idPairs(fromParallel) != idPairs(fromFront) ||
+          parallel.size() != front.size()) {
+        cout << "Frame " << frame << (exact ? " (exact)" : "")
+             << ": front on 4 threads has " << parallel.size() << " pairs and "
+             << fromParallel.size() << " contacts, on 1 thread "
+             << front.size() << " pairs and " << fromFront.size() << " contacts"
+             << endl;
+        ++failures;
+      }
+    }
+  }
+  if (failures > 0) {
+    cout << failures << " frames differ." << endl;
+    return 1;
+  }
+  cout << "All frames match." << endl;
+  return 0;
+}
@@ -0,0 +1,164 @@
+//
+//  DynamicTreeTest.cpp
+//  SphereOctree
+//
+
+// Moves, inserts and removes boxes in a dynamic tree and compares its pairs,
+// region queries and ray casts in each round with the ones of testing all
+// boxes. The coordinates are multiples of 1/4, so many rays run exactly along
+// the faces of boxes.
+
+#include "DynamicTree.h"
+#include <algorithm>
+#include <iostream>
+#include <random>
+#include <vector>
+
+using namespace std;
+
+static const size_t BOXES = 300;
+static const int ROUNDS = 50;
+static const int QUERIES = 200;
+
+namespace {
+
+mt19937 generator(7);
+
+// Returns a multiple of 1/4 in [-10, 10).
+float coordinate() { return (int)(generator() % 80) / 4.0f - 10.0f; }
+
+Eigen::AlignedBox3f randomBox() {
+  Eigen::Vector3f min(coordinate(), coordinate(), coordinate());
+  Eigen::Vector3f size((1 + generator() % 8) / 4.0f,
+                       (1 + generator() % 8) / 4.0f,
+                       (1 + generator() % 8) / 4.0f);
+  return Eigen::AlignedBox3f(min, min + size);
+}
+
+// Returns true, if the ray hits the closed box within 'maxDistance'.
+bool rayHits(const Eigen::Vector3f &origin, const Eigen::Vector3f &direction,
+             float maxDistance, const Eigen::AlignedBox3f &box) {
+  float enter = 0.0f, exit = maxDistance;
+  for (int i = 0; i < 3; ++i) {
+    if (direction[i] == 0.0f) {
+      if (origin[i] < box.min()[i] || origin[i] > box.max()[i])
+        return false;
+    } else {
+      float t0 = (box.min()[i] - origin[i]) / direction[i];
+      float t1 = (box.max()[i] - origin[i]) / direction[i];
+      enter = max(enter, min(t0, t1));
+      exit = min(exit, max(t0, t1));
+    }
+  }
+  return enter <= exit;
+}
+
+vector<size_t> sorted(vector<size_t> objects) {
+  sort(objects.begin(), objects.end());
+  return objects;
+}
+
+} // namespace
+
+int main() {
+  DynamicTree tree;
+  vector<Eigen::AlignedBox3f> boxes(BOXES);
+  vector<bool> inTree(BOXES, false);
+  int failures = 0;
+
+  // A ray along the lower and along the upper face of a box hits it.
+  Eigen::AlignedBox3f face(Eigen::Vector3f(0.0f, 0.0f, 0.0f),
+                           Eigen::Vector3f(1.0f, 1.0f, 1.0f));
+  tree.insert(0, face);
+  for (float y : {0.0f, 1.0f}) {
+    vector<size_t> hits;
+    tree.rayCast(Eigen::Vector3f(-1.0f, y, 0.5f),
+                 Eigen::Vector3f(1.0f, 0.0f, 0.0f), 10.0f, hits);
+    if (hits.size() != 1) {
+      cout << "A ray along the face y = " << y << " misses the box." << endl;
+      ++failures;
+    }
+  }
+  tree.remove(0);
+
+  for (int round = 0; round < ROUNDS; ++round) {
+    // Move most boxes a little, some far, and insert or remove a few.
+    for (size_t i = 0; i < BOXES; ++i) {
+      unsigned change = generator() % 20;
+      if (!inTree[i]) {
+        if (round == 0 || change == 0) {
+          boxes[i] = randomBox();
+          tree.insert(i, boxes[i]);
+          inTree[i] = true;
+        }
+      } else if (change == 0) {
+        tree.remove(i);
+        inTree[i] = false;
+      } else if (change == 1) {
+        boxes[i] = randomBox();
+        tree.move(i, boxes[i]);
+      } else {
+        Eigen::Vector3f step(((int)(generator() % 3) - 1) / 4.0f,
+                             ((int)(generator() % 3) - 1) / 4.0f, 0.0f);
+        boxes[i].translate(step);
+        tree.move(i, boxes[i]);
+      }
+    }
+    tree.updatePairs();
+
+    vector<Broadphase::Pair> pairs;
+    for (size_t i = 0; i < BOXES; ++i) {
+      for (size_t j = i + 1; j < BOXES; ++j) {
+        if (inTree[i] && inTree[j] && boxes[i].intersects(boxes[j]))
+          pairs.push_back(Broadphase::Pair(i, j));
+      }
+    }
+    if (tree.getPairs() != pairs) {
+      cout << "Round " << round << ": tree has " << tree.getPairs().size()
+           << " pairs, instead of " << pairs.size() << endl;
+      ++failures;
+    }
+
+    for (int q = 0; q < QUERIES; ++q) {
+      Eigen::AlignedBox3f region = randomBox();
+      vector<size_t> found, expected;
+      tree.query(region, found);
+      for (size_t i = 0; i < BOXES; ++i) {
+        if (inTree[i] && boxes[i].intersects(region))
+          expected.push_back(i);
+      }
+      if (sorted(found) != expected) {
+        cout << "Round " << round << ": query finds " << found.size()
+             << " boxes, instead of " << expected.size() << endl;
+        ++failures;
+      }
+
+      // Every other ray is parallel to an axis.
+      Eigen::Vector3f origin(coordinate(), coordinate(), coordinate());
+      Eigen::Vector3f direction;
+      if (q % 2 == 0) {
+        direction = Eigen::Vector3f::Zero();
+        direction[q / 2 % 3] = generator() % 2 ? 1.0f : -1.0f;
+      } else {
+        direction = Eigen::Vector3f(coordinate(), coordinate(), coordinate());
+      }
+      float maxDistance = 1.0f + generator() % 20;
+      found.clear();
+      expected.clear();
+      tree.rayCast(origin, direction, maxDistance, found);
+      for (size_t i = 0; i < BOXES; ++i) {
+        if (inTree[i] && rayHits(origin, direction, maxDistance, boxes[i]))
+          expected.push_back(i);
+      }
+      if (sorted(found) != expected) {
+        cout << "Round " << round << ": ray hits " << found.size()
+             << " boxes, instead of " << expected.size() << endl;
+        ++failures;
+      }
+    }
+  }
+  if (failures > 0)
+    return 1;
+  cout << "All pairs, queries and rays match." << endl;
+  return 0;
+}
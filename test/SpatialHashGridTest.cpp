@@ -0,0 +1,71 @@
+//
+//  SpatialHashGridTest.cpp
+//  SphereOctree
+//
+
+// Compares the pairs of the hash grid with the ones of testing all boxes
+// against each other, for small boxes together with one box which covers
+// almost the whole world and a few far away from the origin.
+
+#include "SpatialHashGrid.h"
+#include <iostream>
+#include <random>
+#include <vector>
+
+using namespace std;
+
+static const int BOXES = 500;
+
+namespace {
+
+// Returns the pairs of all intersecting boxes, sorted.
+vector<Broadphase::Pair> allPairs(const vector<Eigen::AlignedBox3f> &boxes) {
+  vector<Broadphase::Pair> pairs;
+  for (size_t i = 0; i < boxes.size(); ++i) {
+    for (size_t j = i + 1; j < boxes.size(); ++j) {
+      if (boxes[i].intersects(boxes[j]))
+        pairs.push_back(Broadphase::Pair(i, j));
+    }
+  }
+  return pairs;
+}
+
+Eigen::AlignedBox3f box(const Eigen::Vector3f &center, float extent) {
+  Eigen::Vector3f e = Eigen::Vector3f::Constant(extent);
+  return Eigen::AlignedBox3f(center - e, center + e);
+}
+
+} // namespace
+
+int main() {
+  mt19937 random(7);
+  vector<Eigen::AlignedBox3f> boxes;
+  for (int i = 0; i < BOXES; ++i) {
+    Eigen::Vector3f center((random() % 2000) / 100.0f - 10.0f,
+                           (random() % 2000) / 100.0f - 10.0f,
+                           (random() % 2000) / 100.0f - 10.0f);
+    boxes.push_back(box(center, 0.2f + (random() % 100) / 100.0f));
+  }
+  // Covers all small boxes and millions of cells.
+  boxes.push_back(box(Eigen::Vector3f(3.0f, 0.0f, 0.0f), 5000.0f));
+  // Their cells do not fit into an int.
+  boxes.push_back(box(Eigen::Vector3f(1e12f, 0.0f, 0.0f), 1.0f));
+  boxes.push_back(box(Eigen::Vector3f(1e12f, 0.5f, 0.0f), 1.0f));
+  boxes.push_back(box(Eigen::Vector3f(-1e12f, -1e12f, 1e12f), 1e11f));
+
+  int failures = 0;
+  for (float cellSize : {0.0f, 0.01f, 1.0f}) {
+    SpatialHashGrid grid(cellSize);
+    grid.update(boxes);
+    if (grid.getPairs() != allPairs(boxes)) {
+      cout << "Cell size " << cellSize << ": grid has "
+           << grid.getPairs().size() << " pairs, instead of "
+           << allPairs(boxes).size() << endl;
+      ++failures;
+    }
+  }
+  if (failures > 0)
+    return 1;
+  cout << "All pairs match." << endl;
+  return 0;
+}